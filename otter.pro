@@ -34,16 +34,20 @@ SOURCES += src/main.cpp \
     src/core/ActionsManager.cpp \
     src/core/AddressCompletionModel.cpp \
     src/core/Application.cpp \
+    src/core/BlockedContentNetworkReply.cpp \
     src/core/BookmarksImporter.cpp \
     src/core/BookmarksManager.cpp \
     src/core/BookmarksModel.cpp \
     src/core/ContentBlockingList.cpp \
     src/core/ContentBlockingManager.cpp \
+    src/core/ContentBlockingMatcher.cpp \
     src/core/Console.cpp \
     src/core/CookieJar.cpp \
     src/core/FileSystemCompleterModel.cpp \
     src/core/GesturesManager.cpp \
     src/core/HistoryManager.cpp \
+    src/core/HistoryModel.cpp \
+    src/core/HistoryWriter.cpp \
     src/core/Importer.cpp \
     src/core/InputInterpreter.cpp \
     src/core/LocalListingNetworkReply.cpp \
@@ -54,6 +58,7 @@ SOURCES += src/main.cpp \
     src/core/NetworkProxyFactory.cpp \
     src/core/Notification.cpp \
     src/core/PlatformIntegration.cpp \
+    src/core/PublicSuffixManager.cpp \
     src/core/SearchesManager.cpp \
     src/core/SearchSuggester.cpp \
     src/core/SessionsManager.cpp \
@@ -125,6 +130,7 @@ SOURCES += src/main.cpp \
     src/modules/windows/bookmarks/BookmarksContentsWidget.cpp \
     src/modules/windows/cache/CacheContentsWidget.cpp \
     src/modules/windows/configuration/ConfigurationContentsWidget.cpp \
+    src/modules/windows/contentblocking/ContentBlockingContentsWidget.cpp \
     src/modules/windows/cookies/CookiesContentsWidget.cpp \
     src/modules/windows/history/HistoryContentsWidget.cpp \
     src/modules/windows/transfers/ProgressBarDelegate.cpp \
@@ -140,16 +146,20 @@ HEADERS += src/core/Action.h \
     src/core/ActionsManager.h \
     src/core/AddressCompletionModel.h \
     src/core/Application.h \
+    src/core/BlockedContentNetworkReply.h \
     src/core/BookmarksImporter.h \
     src/core/BookmarksManager.h \
     src/core/BookmarksModel.h \
     src/core/ContentBlockingList.h \
     src/core/ContentBlockingManager.h \
+    src/core/ContentBlockingMatcher.h \
     src/core/Console.h \
     src/core/CookieJar.h \
     src/core/FileSystemCompleterModel.h \
     src/core/GesturesManager.h \
     src/core/HistoryManager.h \
+    src/core/HistoryModel.h \
+    src/core/HistoryWriter.h \
     src/core/Importer.h \
     src/core/InputInterpreter.h \
     src/core/LocalListingNetworkReply.h \
@@ -160,6 +170,7 @@ HEADERS += src/core/Action.h \
     src/core/NetworkProxyFactory.h \
     src/core/Notification.h \
     src/core/PlatformIntegration.h \
+    src/core/PublicSuffixManager.h \
     src/core/SearchesManager.h \
     src/core/SearchSuggester.h \
     src/core/SessionsManager.h \
@@ -231,6 +242,7 @@ HEADERS += src/core/Action.h \
     src/modules/windows/bookmarks/BookmarksContentsWidget.h \
     src/modules/windows/cache/CacheContentsWidget.h \
     src/modules/windows/configuration/ConfigurationContentsWidget.h \
+    src/modules/windows/contentblocking/ContentBlockingContentsWidget.h \
     src/modules/windows/cookies/CookiesContentsWidget.h \
     src/modules/windows/history/HistoryContentsWidget.h \
     src/modules/windows/transfers/ProgressBarDelegate.h \
@@ -268,6 +280,7 @@ FORMS += src/ui/AuthenticationDialog.ui \
     src/modules/windows/bookmarks/BookmarksContentsWidget.ui \
     src/modules/windows/cache/CacheContentsWidget.ui \
     src/modules/windows/configuration/ConfigurationContentsWidget.ui \
+    src/modules/windows/contentblocking/ContentBlockingContentsWidget.ui \
     src/modules/windows/cookies/CookiesContentsWidget.ui \
     src/modules/windows/history/HistoryContentsWidget.ui \
     src/modules/windows/transfers/TransfersContentsWidget.ui \
@@ -0,0 +1 @@
+CREATE INDEX IF NOT EXISTS "visits_time" ON "visits" ("time");
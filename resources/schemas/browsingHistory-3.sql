@@ -0,0 +1,2 @@
+CREATE INDEX IF NOT EXISTS "visits_location" ON "visits" ("location");
+CREATE INDEX IF NOT EXISTS "visits_icon" ON "visits" ("icon");
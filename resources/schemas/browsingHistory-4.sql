@@ -0,0 +1,6 @@
+DELETE FROM "icons" WHERE NOT EXISTS(SELECT 1 FROM "visits" WHERE "visits"."icon" = "icons"."id");
+DELETE FROM "locations" WHERE NOT EXISTS(SELECT 1 FROM "visits" WHERE "visits"."location" = "locations"."id");
+DELETE FROM "hosts" WHERE NOT EXISTS(SELECT 1 FROM "locations" WHERE "locations"."host" = "hosts"."id");
+CREATE TRIGGER IF NOT EXISTS "visits_cleanup" AFTER DELETE ON "visits" BEGIN DELETE FROM "locations" WHERE "id" = OLD."location" AND NOT EXISTS(SELECT 1 FROM "visits" WHERE "location" = OLD."location"); DELETE FROM "icons" WHERE "id" = OLD."icon" AND NOT EXISTS(SELECT 1 FROM "visits" WHERE "icon" = OLD."icon"); END;
+CREATE TRIGGER IF NOT EXISTS "visits_update_cleanup" AFTER UPDATE OF "location", "icon" ON "visits" BEGIN DELETE FROM "locations" WHERE "id" = OLD."location" AND OLD."location" <> NEW."location" AND NOT EXISTS(SELECT 1 FROM "visits" WHERE "location" = OLD."location"); DELETE FROM "icons" WHERE "id" = OLD."icon" AND OLD."icon" <> NEW."icon" AND NOT EXISTS(SELECT 1 FROM "visits" WHERE "icon" = OLD."icon"); END;
+CREATE TRIGGER IF NOT EXISTS "locations_cleanup" AFTER DELETE ON "locations" BEGIN DELETE FROM "hosts" WHERE "id" = OLD."host" AND NOT EXISTS(SELECT 1 FROM "locations" WHERE "host" = OLD."host"); END;
@@ -0,0 +1,7 @@
+CREATE TABLE IF NOT EXISTS "statistics" ("location" INTEGER PRIMARY KEY, "visits" INTEGER NOT NULL, "typed" INTEGER NOT NULL, "time" INTEGER NOT NULL);
+DROP INDEX IF EXISTS "statistics_visits";
+CREATE INDEX "statistics_visits" ON "statistics" ("visits", "time");
+CREATE TRIGGER IF NOT EXISTS "statistics_insert" AFTER INSERT ON "visits" BEGIN INSERT OR IGNORE INTO "statistics" ("location", "visits", "typed", "time") VALUES(NEW."location", 0, 0, 0); UPDATE "statistics" SET "visits" = ("visits" + 1), "typed" = ("typed" + NEW."typed"), "time" = MAX("time", NEW."time") WHERE "location" = NEW."location"; END;
+CREATE TRIGGER IF NOT EXISTS "statistics_delete" AFTER DELETE ON "visits" BEGIN UPDATE "statistics" SET "visits" = ("visits" - 1), "typed" = ("typed" - OLD."typed"), "time" = IFNULL((SELECT MAX("time") FROM "visits" WHERE "location" = OLD."location"), 0) WHERE "location" = OLD."location"; DELETE FROM "statistics" WHERE "location" = OLD."location" AND "visits" <= 0; END;
+CREATE TRIGGER IF NOT EXISTS "statistics_update" AFTER UPDATE OF "location" ON "visits" WHEN OLD."location" <> NEW."location" BEGIN UPDATE "statistics" SET "visits" = ("visits" - 1), "typed" = ("typed" - OLD."typed"), "time" = IFNULL((SELECT MAX("time") FROM "visits" WHERE "location" = OLD."location"), 0) WHERE "location" = OLD."location"; DELETE FROM "statistics" WHERE "location" = OLD."location" AND "visits" <= 0; INSERT OR IGNORE INTO "statistics" ("location", "visits", "typed", "time") VALUES(NEW."location", 0, 0, 0); UPDATE "statistics" SET "visits" = ("visits" + 1), "typed" = ("typed" + NEW."typed"), "time" = MAX("time", NEW."time") WHERE "location" = NEW."location"; END;
+INSERT OR REPLACE INTO "statistics" ("location", "visits", "typed", "time") SELECT "location", COUNT(*), SUM("typed"), MAX("time") FROM "visits" GROUP BY "location";
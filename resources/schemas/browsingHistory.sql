@@ -1,4 +1,17 @@
+PRAGMA auto_vacuum = INCREMENTAL;
 CREATE TABLE "visits" ("id" INTEGER PRIMARY KEY, "location" INTEGER NOT NULL, "icon" INTEGER NOT NULL, "title" TEXT, "time" INTEGER NOT NULL, "typed" BOOLEAN NOT NULL);
 CREATE TABLE "locations" ("id" INTEGER PRIMARY KEY, "host" INTEGER NOT NULL, "scheme" TEXT NOT NULL, "path" TEXT, UNIQUE("host", "scheme", "path"));
 CREATE TABLE "hosts" ("id" INTEGER PRIMARY KEY, "host" TEXT UNIQUE NOT NULL);
-CREATE TABLE "icons" ("id" INTEGER PRIMARY KEY, "icon" BLOB UNIQUE NOT NULL);
+CREATE TABLE "icons" ("id" INTEGER PRIMARY KEY, "hash" INTEGER NOT NULL, "icon" BLOB NOT NULL);
+CREATE TABLE "statistics" ("location" INTEGER PRIMARY KEY, "visits" INTEGER NOT NULL, "typed" INTEGER NOT NULL, "time" INTEGER NOT NULL);
+CREATE INDEX "visits_time" ON "visits" ("time");
+CREATE INDEX "visits_location" ON "visits" ("location");
+CREATE INDEX "visits_icon" ON "visits" ("icon");
+CREATE INDEX "icons_hash" ON "icons" ("hash");
+CREATE INDEX "statistics_visits" ON "statistics" ("visits", "time");
+CREATE TRIGGER "visits_cleanup" AFTER DELETE ON "visits" BEGIN DELETE FROM "locations" WHERE "id" = OLD."location" AND NOT EXISTS(SELECT 1 FROM "visits" WHERE "location" = OLD."location"); DELETE FROM "icons" WHERE "id" = OLD."icon" AND NOT EXISTS(SELECT 1 FROM "visits" WHERE "icon" = OLD."icon"); END;
+CREATE TRIGGER "visits_update_cleanup" AFTER UPDATE OF "location", "icon" ON "visits" BEGIN DELETE FROM "locations" WHERE "id" = OLD."location" AND OLD."location" <> NEW."location" AND NOT EXISTS(SELECT 1 FROM "visits" WHERE "location" = OLD."location"); DELETE FROM "icons" WHERE "id" = OLD."icon" AND OLD."icon" <> NEW."icon" AND NOT EXISTS(SELECT 1 FROM "visits" WHERE "icon" = OLD."icon"); END;
+CREATE TRIGGER "locations_cleanup" AFTER DELETE ON "locations" BEGIN DELETE FROM "hosts" WHERE "id" = OLD."host" AND NOT EXISTS(SELECT 1 FROM "locations" WHERE "host" = OLD."host"); END;
+CREATE TRIGGER "statistics_insert" AFTER INSERT ON "visits" BEGIN INSERT OR IGNORE INTO "statistics" ("location", "visits", "typed", "time") VALUES(NEW."location", 0, 0, 0); UPDATE "statistics" SET "visits" = ("visits" + 1), "typed" = ("typed" + NEW."typed"), "time" = MAX("time", NEW."time") WHERE "location" = NEW."location"; END;
+CREATE TRIGGER "statistics_delete" AFTER DELETE ON "visits" BEGIN UPDATE "statistics" SET "visits" = ("visits" - 1), "typed" = ("typed" - OLD."typed"), "time" = IFNULL((SELECT MAX("time") FROM "visits" WHERE "location" = OLD."location"), 0) WHERE "location" = OLD."location"; DELETE FROM "statistics" WHERE "location" = OLD."location" AND "visits" <= 0; END;
+CREATE TRIGGER "statistics_update" AFTER UPDATE OF "location" ON "visits" WHEN OLD."location" <> NEW."location" BEGIN UPDATE "statistics" SET "visits" = ("visits" - 1), "typed" = ("typed" - OLD."typed"), "time" = IFNULL((SELECT MAX("time") FROM "visits" WHERE "location" = OLD."location"), 0) WHERE "location" = OLD."location"; DELETE FROM "statistics" WHERE "location" = OLD."location" AND "visits" <= 0; INSERT OR IGNORE INTO "statistics" ("location", "visits", "typed", "time") VALUES(NEW."location", 0, 0, 0); UPDATE "statistics" SET "visits" = ("visits" + 1), "typed" = ("typed" + NEW."typed"), "time" = MAX("time", NEW."time") WHERE "location" = NEW."location"; END;
@@ -19,9 +19,11 @@
 
 #include "AddressCompletionModel.h"
 #include "BookmarksManager.h"
+#include "HistoryManager.h"
 #include "SettingsManager.h"
 
 #include <QtCore/QCoreApplication>
+#include <QtCore/QDateTime>
 
 namespace Otter
 {
@@ -29,50 +31,346 @@ namespace Otter
 AddressCompletionModel* AddressCompletionModel::m_instance = NULL;
 
 AddressCompletionModel::AddressCompletionModel(QObject *parent) : QAbstractListModel(parent),
-	m_updateTimer(0)
+	m_updateTimer(0),
+	m_reloadTimer(0)
 {
-	m_updateTimer = startTimer(250);
+	m_reloadTimer = startTimer(250);
 
 	connect(BookmarksManager::getInstance(), SIGNAL(modelModified()), this, SLOT(updateCompletion()));
+	connect(HistoryManager::getInstance(), SIGNAL(entryAdded(qint64)), this, SLOT(addHistoryEntry(qint64)));
+	connect(HistoryManager::getInstance(), SIGNAL(entryUpdated(qint64)), this, SLOT(updateHistoryEntry(qint64)));
+	connect(HistoryManager::getInstance(), SIGNAL(visitRemoved(QUrl)), this, SLOT(removeHistoryEntry(QUrl)));
+	connect(HistoryManager::getInstance(), SIGNAL(cleared()), this, SLOT(reloadCompletion()));
 	connect(SettingsManager::getInstance(), SIGNAL(valueChanged(QString,QVariant)), this, SLOT(optionChanged(QString)));
 }
 
 void AddressCompletionModel::timerEvent(QTimerEvent *event)
 {
-	if (event->timerId() == m_updateTimer)
+	if (event->timerId() == m_reloadTimer)
+	{
+		killTimer(m_reloadTimer);
+
+		m_reloadTimer = 0;
+
+		if (m_updateTimer != 0)
+		{
+			killTimer(m_updateTimer);
+
+			m_updateTimer = 0;
+		}
+
+		reloadEntries();
+	}
+	else if (event->timerId() == m_updateTimer)
 	{
 		killTimer(m_updateTimer);
 
 		m_updateTimer = 0;
 
-		QStringList urls;
-		urls << QLatin1String("about:bookmarks") << QLatin1String("about:cache") << QLatin1String("about:config") << QLatin1String("about:cookies") << QLatin1String("about:history") << QLatin1String("about:transfers");
-		urls << BookmarksManager::getUrls();
+		updateBookmarks();
+	}
+}
+
+void AddressCompletionModel::reloadEntries()
+{
+	m_entries.clear();
+	m_keys.clear();
+	m_entryIndexes.clear();
+	m_cache.clear();
+
+	QStringList urls;
+	urls << QLatin1String("about:bookmarks") << QLatin1String("about:cache") << QLatin1String("about:config") << QLatin1String("about:contentblocking") << QLatin1String("about:cookies") << QLatin1String("about:history") << QLatin1String("about:transfers");
+
+	for (int i = 0; i < urls.count(); ++i)
+	{
+		CompletionEntry entry;
+		entry.url = urls.at(i);
+		entry.isSpecial = true;
+
+		m_entryIndexes[entry.url] = m_entries.count();
+		m_entries.append(entry);
+	}
+
+	const QList<HistoryEntry> locations = HistoryManager::getLocations();
+
+	m_entries.reserve(m_entries.count() + locations.count());
+
+	for (int i = 0; i < locations.count(); ++i)
+	{
+		const QString url = locations.at(i).url.toString();
+		CompletionEntry &entry = m_entries[addEntry(url)];
+		entry.time = qMax(entry.time, locations.at(i).time.toTime_t());
+		entry.visits += locations.at(i).visits;
+		entry.isTyped = (entry.isTyped || locations.at(i).typed);
+	}
+
+	if (SettingsManager::getValue(QLatin1String("AddressField/SuggestBookmarks")).toBool())
+	{
+		const QStringList bookmarks = BookmarksManager::getUrls();
+
+		for (int i = 0; i < bookmarks.count(); ++i)
+		{
+			m_entries[addEntry(bookmarks.at(i))].isBookmark = true;
+		}
+	}
+
+	m_keys.reserve(m_entries.count() * 2);
+
+	for (int i = 0; i < m_entries.count(); ++i)
+	{
+		addKeys(i, false);
+	}
+
+	qSort(m_keys);
+
+	const QString filter = m_filter;
+
+	m_filter = QString();
+
+	setFilter(filter);
+}
+
+void AddressCompletionModel::updateBookmarks()
+{
+	const bool suggestBookmarks = SettingsManager::getValue(QLatin1String("AddressField/SuggestBookmarks")).toBool();
+	const QStringList bookmarks = (suggestBookmarks ? BookmarksManager::getUrls() : QStringList());
+
+	for (int i = 0; i < m_entries.count(); ++i)
+	{
+		m_entries[i].isBookmark = false;
+	}
 
-		beginResetModel();
+	for (int i = 0; i < bookmarks.count(); ++i)
+	{
+		const bool isNew = !m_entryIndexes.contains(bookmarks.at(i));
+		const int entry = addEntry(bookmarks.at(i));
 
-		m_urls = urls;
+		m_entries[entry].isBookmark = true;
 
-		endResetModel();
+		if (isNew)
+		{
+			addKeys(entry, true);
+		}
 	}
+
+	m_cache.clear();
+
+	const QString filter = m_filter;
+
+	m_filter = QString();
+
+	setFilter(filter);
+}
+
+void AddressCompletionModel::addKeys(int entry, bool isSorted)
+{
+	const QString url = m_entries.at(entry).url;
+	QList<int> offsets;
+
+	const int schemeEnd = url.indexOf(QLatin1String("://"));
+
+	if (schemeEnd > 0)
+	{
+		offsets.append(schemeEnd + 3);
+
+		if (url.midRef(schemeEnd + 3, 4) == QLatin1String("www."))
+		{
+			offsets.append(schemeEnd + 7);
+		}
+	}
+	else
+	{
+		offsets.append(0);
+	}
+
+	for (int i = 0; i < offsets.count(); ++i)
+	{
+		const CompletionKey key(url.mid(offsets.at(i)).toLower(), entry, offsets.at(i));
+
+		if (isSorted)
+		{
+			m_keys.insert(qUpperBound(m_keys.begin(), m_keys.end(), key), key);
+		}
+		else
+		{
+			m_keys.append(key);
+		}
+	}
+}
+
+void AddressCompletionModel::addHistoryEntry(qint64 entry)
+{
+	updateHistoryEntry(entry, true);
+}
+
+void AddressCompletionModel::updateHistoryEntry(qint64 entry)
+{
+	updateHistoryEntry(entry, false);
+}
+
+void AddressCompletionModel::updateHistoryEntry(qint64 entry, bool isVisit)
+{
+	const HistoryEntry historyEntry = HistoryManager::getEntry(entry);
+
+	if (historyEntry.identifier < 0)
+	{
+		return;
+	}
+
+	const QString url = historyEntry.url.toString();
+	const bool isNew = !m_entryIndexes.contains(url);
+	const int index = addEntry(url);
+	CompletionEntry &completionEntry = m_entries[index];
+	completionEntry.time = qMax(completionEntry.time, historyEntry.time.toTime_t());
+	completionEntry.isTyped = (completionEntry.isTyped || historyEntry.typed);
+
+	if (isVisit || completionEntry.visits == 0)
+	{
+		++completionEntry.visits;
+	}
+
+	if (isNew)
+	{
+		addKeys(index, true);
+	}
+
+	m_cache.clear();
+}
+
+void AddressCompletionModel::removeHistoryEntry(const QUrl &url)
+{
+	const QString key = url.toString();
+
+	if (!m_entryIndexes.contains(key))
+	{
+		return;
+	}
+
+	CompletionEntry &entry = m_entries[m_entryIndexes[key]];
+
+	if (entry.visits > 0)
+	{
+		--entry.visits;
+	}
+
+	m_cache.clear();
 }
 
 void AddressCompletionModel::optionChanged(const QString &option)
 {
 	if (option.contains(QLatin1String("AddressField/Suggest")))
 	{
-		updateCompletion();
+		reloadCompletion();
 	}
 }
 
 void AddressCompletionModel::updateCompletion()
 {
-	if (m_updateTimer == 0)
+	if (m_updateTimer == 0 && m_reloadTimer == 0)
 	{
 		m_updateTimer = startTimer(250);
 	}
 }
 
+void AddressCompletionModel::reloadCompletion()
+{
+	if (m_reloadTimer == 0)
+	{
+		m_reloadTimer = startTimer(250);
+	}
+}
+
+void AddressCompletionModel::setFilter(const QString &filter)
+{
+	if (filter == m_filter && !m_results.isEmpty())
+	{
+		return;
+	}
+
+	m_filter = filter;
+
+	const QString prefix = filter.toLower();
+	const int schemeEnd = prefix.indexOf(QLatin1String("://"));
+	const QString keyPrefix = ((schemeEnd >= 0) ? prefix.mid(schemeEnd + 3) : prefix);
+	QStringList results;
+
+	if (!keyPrefix.isEmpty())
+	{
+		if (m_cache.contains(prefix))
+		{
+			results = m_cache.value(prefix);
+		}
+		else
+		{
+			const uint now = QDateTime::currentDateTime().toTime_t();
+			QList<QPair<int, int> > matches;
+			QVector<CompletionKey>::const_iterator iterator = qLowerBound(m_keys.constBegin(), m_keys.constEnd(), CompletionKey(keyPrefix));
+
+			for (; iterator != m_keys.constEnd() && iterator->key.startsWith(keyPrefix); ++iterator)
+			{
+				if (schemeEnd >= 0 && !m_entries.at(iterator->entry).url.startsWith(prefix, Qt::CaseInsensitive))
+				{
+					continue;
+				}
+
+				const int score = getScore(m_entries.at(iterator->entry), now);
+
+				if (score > 0 && (matches.count() < 20 || score > matches.last().first))
+				{
+					bool isDuplicate = false;
+
+					for (int i = 0; i < matches.count(); ++i)
+					{
+						if (m_keys.at(matches.at(i).second).entry == iterator->entry)
+						{
+							isDuplicate = true;
+
+							break;
+						}
+					}
+
+					if (!isDuplicate)
+					{
+						int position = matches.count();
+
+						while (position > 0 && matches.at(position - 1).first < score)
+						{
+							--position;
+						}
+
+						matches.insert(position, qMakePair(score, int(iterator - m_keys.constBegin())));
+
+						if (matches.count() > 20)
+						{
+							matches.removeLast();
+						}
+					}
+				}
+			}
+
+			for (int i = 0; i < matches.count(); ++i)
+			{
+				const CompletionKey &key = m_keys.at(matches.at(i).second);
+
+				results.append((schemeEnd >= 0) ? m_entries.at(key.entry).url : m_entries.at(key.entry).url.mid(key.offset));
+			}
+
+			if (m_cache.count() > 100)
+			{
+				m_cache.clear();
+			}
+
+			m_cache[prefix] = results;
+		}
+	}
+
+	beginResetModel();
+
+	m_results = results;
+
+	endResetModel();
+}
+
 AddressCompletionModel* AddressCompletionModel::getInstance()
 {
 	if (!m_instance)
@@ -85,9 +383,9 @@ AddressCompletionModel* AddressCompletionModel::getInstance()
 
 QVariant AddressCompletionModel::data(const QModelIndex &index, int role) const
 {
-	if (role == Qt::DisplayRole && index.column() == 0 && index.row() >= 0 && index.row() < m_urls.count())
+	if (role == Qt::DisplayRole && index.column() == 0 && index.row() >= 0 && index.row() < m_results.count())
 	{
-		return m_urls.at(index.row());
+		return m_results.at(index.row());
 	}
 
 	return QVariant();
@@ -102,9 +400,62 @@ QVariant AddressCompletionModel::headerData(int section, Qt::Orientation orienta
 	return QVariant();
 }
 
+int AddressCompletionModel::addEntry(const QString &url)
+{
+	if (m_entryIndexes.contains(url))
+	{
+		return m_entryIndexes[url];
+	}
+
+	CompletionEntry entry;
+	entry.url = url;
+
+	m_entryIndexes[url] = m_entries.count();
+	m_entries.append(entry);
+
+	return (m_entries.count() - 1);
+}
+
+int AddressCompletionModel::getScore(const CompletionEntry &entry, uint now) const
+{
+	if (entry.isSpecial)
+	{
+		return 1;
+	}
+
+	int score = (entry.isBookmark ? 140 : 0);
+
+	if (entry.visits > 0)
+	{
+		const uint age = ((now > entry.time) ? ((now - entry.time) / 86400) : 0);
+		int weight = 10;
+
+		if (age <= 4)
+		{
+			weight = 100;
+		}
+		else if (age <= 14)
+		{
+			weight = 70;
+		}
+		else if (age <= 31)
+		{
+			weight = 50;
+		}
+		else if (age <= 90)
+		{
+			weight = 30;
+		}
+
+		score += (entry.visits * weight * (entry.isTyped ? 2 : 1));
+	}
+
+	return score;
+}
+
 int AddressCompletionModel::rowCount(const QModelIndex &index) const
 {
-	return (index.isValid() ? 0 : m_urls.count());
+	return (index.isValid() ? 0 : m_results.count());
 }
 
 }
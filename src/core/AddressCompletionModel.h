@@ -21,6 +21,9 @@
 #define OTTER_ADDRESSCOMPLETIONMODEL_H
 
 #include <QtCore/QAbstractListModel>
+#include <QtCore/QHash>
+#include <QtCore/QUrl>
+#include <QtCore/QVector>
 
 namespace Otter
 {
@@ -31,22 +34,65 @@ class AddressCompletionModel : public QAbstractListModel
 
 public:
 	static AddressCompletionModel* getInstance();
+	void setFilter(const QString &filter);
 	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
 	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
 	int rowCount(const QModelIndex &index = QModelIndex()) const;
 
 protected:
+	struct CompletionEntry
+	{
+		QString url;
+		uint time;
+		int visits;
+		bool isTyped;
+		bool isBookmark;
+		bool isSpecial;
+
+		CompletionEntry() : time(0), visits(0), isTyped(false), isBookmark(false), isSpecial(false) {}
+	};
+
+	struct CompletionKey
+	{
+		QString key;
+		int entry;
+		int offset;
+
+		CompletionKey(const QString &keyValue = QString(), int entryValue = -1, int offsetValue = 0) : key(keyValue), entry(entryValue), offset(offsetValue) {}
+
+		bool operator<(const CompletionKey &other) const
+		{
+			return (key < other.key);
+		}
+	};
+
 	void timerEvent(QTimerEvent *event);
+	void reloadEntries();
+	void updateBookmarks();
+	void addKeys(int entry, bool isSorted);
+	void updateHistoryEntry(qint64 entry, bool isVisit);
+	int addEntry(const QString &url);
+	int getScore(const CompletionEntry &entry, uint now) const;
 
 protected slots:
 	void optionChanged(const QString &option);
 	void updateCompletion();
+	void reloadCompletion();
+	void addHistoryEntry(qint64 entry);
+	void updateHistoryEntry(qint64 entry);
+	void removeHistoryEntry(const QUrl &url);
 
 private:
 	explicit AddressCompletionModel(QObject *parent = NULL);
 
-	QStringList m_urls;
+	QString m_filter;
+	QStringList m_results;
+	QVector<CompletionEntry> m_entries;
+	QVector<CompletionKey> m_keys;
+	QHash<QString, int> m_entryIndexes;
+	QHash<QString, QStringList> m_cache;
 	int m_updateTimer;
+	int m_reloadTimer;
 
 	static AddressCompletionModel *m_instance;
 };
@@ -22,6 +22,7 @@
 #include "Console.h"
 #include "HistoryManager.h"
 #include "NetworkManagerFactory.h"
+#include "PublicSuffixManager.h"
 #include "SearchesManager.h"
 #include "SettingsManager.h"
 #include "TransfersManager.h"
@@ -184,6 +185,8 @@ Application::Application(int &argc, char **argv) : QApplication(argc, argv),
 
 	SessionsManager::createInstance(profilePath, cachePath, isPrivate, this);
 
+	PublicSuffixManager::createInstance(this);
+
 	NetworkManagerFactory::createInstance(this);
 
 	BookmarksManager::createInstance(this);
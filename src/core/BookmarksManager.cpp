@@ -24,7 +24,11 @@
 #include "SessionsManager.h"
 #include "SettingsManager.h"
 
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtCore/QDataStream>
 #include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
 #include <QtCore/QSet>
 #include <QtCore/QTimer>
 #include <QtCore/QUrl>
@@ -35,21 +39,57 @@ namespace Otter
 
 BookmarksManager* BookmarksManager::m_instance = NULL;
 BookmarksModel* BookmarksManager::m_model = NULL;
+bool BookmarksManager::m_isLoaded = false;
+bool BookmarksManager::m_isPopulating = false;
 
 BookmarksManager::BookmarksManager(QObject *parent) : QObject(parent),
-	 m_saveTimer(0)
+	m_journalEntries(0),
+	m_saveTimer(0),
+	m_statisticsTimer(0)
 {
+	m_model = new BookmarksModel(this);
+
+	connect(m_model, SIGNAL(itemChanged(QStandardItem*)), this, SLOT(journalChange(QStandardItem*)));
+	connect(m_model, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(journalInsert(QModelIndex,int,int)));
+	connect(m_model, SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(journalRemove(QModelIndex,int,int)));
+	connect(m_model, SIGNAL(rowsMoved(QModelIndex,int,int,QModelIndex,int)), this, SLOT(scheduleSave()));
+	connect(&m_loadWatcher, SIGNAL(finished()), this, SLOT(bookmarksLoaded()));
+
+	m_loadWatcher.setFuture(QtConcurrent::run(&BookmarksManager::loadBookmarks, SessionsManager::getProfilePath()));
+}
+
+BookmarksManager::~BookmarksManager()
+{
+	if (m_statisticsTimer != 0)
+	{
+		saveStatistics();
+	}
 }
 
 void BookmarksManager::timerEvent(QTimerEvent *event)
 {
-	if (event->timerId() == m_saveTimer)
+	if (event->timerId() == m_statisticsTimer)
+	{
+		killTimer(m_statisticsTimer);
+
+		m_statisticsTimer = 0;
+
+		saveStatistics();
+	}
+	else if (event->timerId() == m_saveTimer)
 	{
 		killTimer(m_saveTimer);
 
 		m_saveTimer = 0;
 
-		save();
+		if (m_isLoaded)
+		{
+			save();
+		}
+		else
+		{
+			m_saveTimer = startTimer(1000);
+		}
 	}
 }
 
@@ -63,6 +103,11 @@ void BookmarksManager::createInstance(QObject *parent)
 
 void BookmarksManager::scheduleSave()
 {
+	if (m_isPopulating)
+	{
+		return;
+	}
+
 	if (m_saveTimer == 0)
 	{
 		m_saveTimer = startTimer(1000);
@@ -71,15 +116,187 @@ void BookmarksManager::scheduleSave()
 	emit modelModified();
 }
 
-void BookmarksManager::readBookmark(QXmlStreamReader *reader, BookmarksItem *parent)
+void BookmarksManager::journalInsert(const QModelIndex &parent, int first, int last)
+{
+	if (m_isPopulating)
+	{
+		return;
+	}
+
+	const QList<int> path = getPath(parent);
+
+	if (!m_isLoaded)
+	{
+		scheduleSave();
+
+		return;
+	}
+
+	if (!path.isEmpty() && path.first() == 0)
+	{
+		for (int i = first; i <= last; ++i)
+		{
+			QStandardItem *bookmark = m_model->itemFromIndex(m_model->index(i, 0, parent));
+
+			if (bookmark)
+			{
+				QByteArray record;
+				QDataStream stream(&record, QIODevice::WriteOnly);
+				stream.setVersion(QDataStream::Qt_5_2);
+				stream << quint8(InsertOperation) << path << qint32(i);
+
+				writeSnapshotNode(stream, getNode(bookmark));
+
+				appendJournal(record);
+			}
+		}
+	}
+
+	emit modelModified();
+}
+
+void BookmarksManager::journalRemove(const QModelIndex &parent, int first, int last)
+{
+	if (m_isPopulating)
+	{
+		return;
+	}
+
+	const QList<int> path = getPath(parent);
+
+	if (!m_isLoaded)
+	{
+		scheduleSave();
+
+		return;
+	}
+
+	if (!path.isEmpty() && path.first() == 0)
+	{
+		QByteArray record;
+		QDataStream stream(&record, QIODevice::WriteOnly);
+		stream.setVersion(QDataStream::Qt_5_2);
+		stream << quint8(RemoveOperation) << path << qint32(first) << qint32(last - first + 1);
+
+		appendJournal(record);
+	}
+
+	scheduleStatisticsSave();
+
+	emit modelModified();
+}
+
+void BookmarksManager::journalChange(QStandardItem *bookmark)
+{
+	if (m_isPopulating || !bookmark)
+	{
+		return;
+	}
+
+	const QList<int> path = getPath(bookmark->index());
+
+	if (!m_isLoaded)
+	{
+		scheduleSave();
+
+		return;
+	}
+
+	if (path.count() > 1 && path.first() == 0)
+	{
+		BookmarksNode node = getNode(bookmark);
+		node.children.clear();
+
+		QByteArray record;
+		QDataStream stream(&record, QIODevice::WriteOnly);
+		stream.setVersion(QDataStream::Qt_5_2);
+		stream << quint8(ChangeOperation) << path;
+
+		writeSnapshotNode(stream, node);
+
+		appendJournal(record);
+	}
+
+	scheduleStatisticsSave();
+
+	emit modelModified();
+}
+
+void BookmarksManager::appendJournal(const QByteArray &record)
+{
+	const QString path = SessionsManager::getProfilePath() + QLatin1String("/bookmarks.journal");
+	QFile file(path);
+	const bool isNew = !file.exists();
+
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+	{
+		scheduleSave();
+
+		return;
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_2);
+
+	if (isNew)
+	{
+		const QFileInfo fileInformation(SessionsManager::getProfilePath() + QLatin1String("/bookmarks.xbel"));
+
+		stream << quint32(0x4F424A4E) << quint32(1) << fileInformation.size() << fileInformation.lastModified();
+	}
+
+	stream << record;
+
+	file.close();
+
+	++m_journalEntries;
+
+	if (m_journalEntries > 100)
+	{
+		scheduleSave();
+	}
+}
+
+void BookmarksManager::scheduleStatisticsSave()
 {
-	BookmarksItem *bookmark = NULL;
+	if (m_statisticsTimer == 0)
+	{
+		m_statisticsTimer = startTimer(30000);
+	}
+}
+
+void BookmarksManager::saveStatistics()
+{
+	QSaveFile file(SessionsManager::getProfilePath() + QLatin1String("/bookmarksStatistics.dat"));
+
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		return;
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_2);
+	stream << quint32(0x4F425354) << quint32(1) << qint32(BookmarksItem::m_statistics.count());
+
+	QHash<QString, BookmarkStatistics>::const_iterator iterator;
+
+	for (iterator = BookmarksItem::m_statistics.constBegin(); iterator != BookmarksItem::m_statistics.constEnd(); ++iterator)
+	{
+		stream << iterator.key() << qint32(iterator.value().visits) << iterator.value().timeVisited;
+	}
+
+	file.commit();
+}
+
+void BookmarksManager::readBookmark(QXmlStreamReader *reader, BookmarksNode *parent)
+{
+	BookmarksNode bookmark;
 
 	if (reader->name() == QLatin1String("folder"))
 	{
-		bookmark = new BookmarksItem(BookmarksItem::FolderBookmark);
-		bookmark->setData(QDateTime::fromString(reader->attributes().value(QLatin1String("added")).toString(), Qt::ISODate), BookmarksModel::TimeAddedRole);
-		bookmark->setData(QDateTime::fromString(reader->attributes().value(QLatin1String("modified")).toString(), Qt::ISODate), BookmarksModel::TimeModifiedRole);
+		bookmark.type = BookmarksItem::FolderBookmark;
+		bookmark.timeAdded = QDateTime::fromString(reader->attributes().value(QLatin1String("added")).toString(), Qt::ISODate);
+		bookmark.timeModified = QDateTime::fromString(reader->attributes().value(QLatin1String("modified")).toString(), Qt::ISODate);
 
 		while (reader->readNext())
 		{
@@ -87,15 +304,15 @@ void BookmarksManager::readBookmark(QXmlStreamReader *reader, BookmarksItem *par
 			{
 				if (reader->name() == QLatin1String("title"))
 				{
-					bookmark->setData(reader->readElementText().trimmed(), BookmarksModel::TitleRole);
+					bookmark.title = reader->readElementText().trimmed();
 				}
 				else if (reader->name() == QLatin1String("desc"))
 				{
-					bookmark->setData(reader->readElementText().trimmed(), BookmarksModel::DescriptionRole);
+					bookmark.description = reader->readElementText().trimmed();
 				}
 				else if (reader->name() == QLatin1String("folder") || reader->name() == QLatin1String("bookmark") || reader->name() == QLatin1String("separator"))
 				{
-					readBookmark(reader, bookmark);
+					readBookmark(reader, &bookmark);
 				}
 				else if (reader->name() == QLatin1String("info"))
 				{
@@ -111,7 +328,7 @@ void BookmarksManager::readBookmark(QXmlStreamReader *reader, BookmarksItem *par
 									{
 										if (reader->name() == QLatin1String("keyword"))
 										{
-											bookmark->setData(reader->readElementText().trimmed(), BookmarksModel::KeywordRole);
+											bookmark.keyword = reader->readElementText().trimmed();
 										}
 										else
 										{
@@ -152,10 +369,11 @@ void BookmarksManager::readBookmark(QXmlStreamReader *reader, BookmarksItem *par
 	}
 	else if (reader->name() == QLatin1String("bookmark"))
 	{
-		bookmark = new BookmarksItem(BookmarksItem::UrlBookmark, reader->attributes().value(QLatin1String("href")).toString());
-		bookmark->setData(QDateTime::fromString(reader->attributes().value(QLatin1String("added")).toString(), Qt::ISODate), BookmarksModel::TimeAddedRole);
-		bookmark->setData(QDateTime::fromString(reader->attributes().value(QLatin1String("modified")).toString(), Qt::ISODate), BookmarksModel::TimeModifiedRole);
-		bookmark->setData(QDateTime::fromString(reader->attributes().value(QLatin1String("visited")).toString(), Qt::ISODate), BookmarksModel::TimeVisitedRole);
+		bookmark.type = BookmarksItem::UrlBookmark;
+		bookmark.url = reader->attributes().value(QLatin1String("href")).toString();
+		bookmark.timeAdded = QDateTime::fromString(reader->attributes().value(QLatin1String("added")).toString(), Qt::ISODate);
+		bookmark.timeModified = QDateTime::fromString(reader->attributes().value(QLatin1String("modified")).toString(), Qt::ISODate);
+		bookmark.timeVisited = QDateTime::fromString(reader->attributes().value(QLatin1String("visited")).toString(), Qt::ISODate);
 
 		while (reader->readNext())
 		{
@@ -163,11 +381,11 @@ void BookmarksManager::readBookmark(QXmlStreamReader *reader, BookmarksItem *par
 			{
 				if (reader->name() == QLatin1String("title"))
 				{
-					bookmark->setData(reader->readElementText().trimmed(), BookmarksModel::TitleRole);
+					bookmark.title = reader->readElementText().trimmed();
 				}
 				else if (reader->name() == QLatin1String("desc"))
 				{
-					bookmark->setData(reader->readElementText().trimmed(), BookmarksModel::DescriptionRole);
+					bookmark.description = reader->readElementText().trimmed();
 				}
 				else if (reader->name() == QLatin1String("info"))
 				{
@@ -183,11 +401,11 @@ void BookmarksManager::readBookmark(QXmlStreamReader *reader, BookmarksItem *par
 									{
 										if (reader->name() == QLatin1String("keyword"))
 										{
-											bookmark->setData(reader->readElementText().trimmed(), BookmarksModel::KeywordRole);
+											bookmark.keyword = reader->readElementText().trimmed();
 										}
 										else if (reader->name() == QLatin1String("visits"))
 										{
-											bookmark->setData(reader->readElementText().toInt(), BookmarksModel::VisitsRole);
+											bookmark.visits = reader->readElementText().toInt();
 										}
 										else
 										{
@@ -228,12 +446,15 @@ void BookmarksManager::readBookmark(QXmlStreamReader *reader, BookmarksItem *par
 	}
 	else if (reader->name() == QLatin1String("separator"))
 	{
-		bookmark = new BookmarksItem(BookmarksItem::SeparatorBookmark);
+		bookmark.type = BookmarksItem::SeparatorBookmark;
 
 		reader->readNext();
 	}
 
-	parent->appendRow(bookmark);
+	if (bookmark.type != BookmarksItem::UnknownBookmark)
+	{
+		parent->children.append(bookmark);
+	}
 }
 
 void BookmarksManager::writeBookmark(QXmlStreamWriter *writer, QStandardItem *bookmark)
@@ -345,15 +566,14 @@ void BookmarksManager::writeBookmark(QXmlStreamWriter *writer, QStandardItem *bo
 
 void BookmarksManager::updateVisits(const QString &url)
 {
-	if (BookmarksItem::hasBookmark(url))
+	const QList<BookmarksItem*> bookmarks = BookmarksItem::getBookmarks(QUrl(url).toString());
+
+	if (!bookmarks.isEmpty())
 	{
-		const QList<BookmarksItem*> bookmarks = BookmarksItem::getBookmarks(url);
+		bookmarks.first()->setData((bookmarks.first()->data(BookmarksModel::VisitsRole).toInt() + 1), BookmarksModel::VisitsRole);
+		bookmarks.first()->setData(QDateTime::currentDateTime(), BookmarksModel::TimeVisitedRole);
 
-		for (int i = 0; i < bookmarks.count(); ++i)
-		{
-			bookmarks.at(i)->setData(bookmarks.at(i)->data(BookmarksModel::VisitsRole).toInt(), BookmarksModel::VisitsRole);
-			bookmarks.at(i)->setData(QDateTime::currentDateTime(), BookmarksModel::TimeVisitedRole);
-		}
+		m_instance->scheduleStatisticsSave();
 	}
 }
 
@@ -372,31 +592,157 @@ void BookmarksManager::deleteBookmark(const QString &url)
 	}
 }
 
-BookmarksManager* BookmarksManager::getInstance()
+void BookmarksManager::bookmarksLoaded()
 {
-	return m_instance;
+	const BookmarksSnapshot snapshot = m_loadWatcher.result();
+
+	if (snapshot.hasParseError)
+	{
+		QMessageBox::warning(NULL, tr("Error"), tr("Failed to parse bookmarks file. No bookmarks were loaded."), QMessageBox::Close);
+		Console::addMessage(tr("Failed to load bookmarks file properly, QXmlStreamReader error code: %1").arg(snapshot.error), OtherMessageCategory, ErrorMessageLevel);
+	}
+	else if (!snapshot.error.isEmpty())
+	{
+		Console::addMessage(tr("Failed to open bookmarks file: %0").arg(snapshot.error), OtherMessageCategory, ErrorMessageLevel);
+	}
+
+	BookmarksItem::m_statistics = snapshot.statistics;
+
+	m_journalEntries = snapshot.journalEntries;
+
+	m_isPopulating = true;
+
+	for (int i = 0; i < snapshot.root.children.count(); ++i)
+	{
+		m_model->getRootItem()->appendRow(createBookmark(snapshot.root.children.at(i)));
+	}
+
+	m_isPopulating = false;
+	m_isLoaded = true;
+
+	QHash<QString, BookmarkStatistics>::iterator iterator = BookmarksItem::m_statistics.begin();
+
+	while (iterator != BookmarksItem::m_statistics.end())
+	{
+		if (BookmarksItem::hasUrl(iterator.key()))
+		{
+			++iterator;
+		}
+		else
+		{
+			iterator = BookmarksItem::m_statistics.erase(iterator);
+		}
+	}
+
+	if (!snapshot.isJournalValid)
+	{
+		Console::addMessage(tr("Failed to replay bookmarks journal, some recent changes may be lost"), OtherMessageCategory, WarningMessageLevel);
+
+		QFile::remove(SessionsManager::getProfilePath() + QLatin1String("/bookmarks.journal"));
+
+		m_journalEntries = 0;
+
+		scheduleSave();
+
+		return;
+	}
+
+	emit modelModified();
 }
 
-BookmarksModel* BookmarksManager::getModel()
+BookmarksItem* BookmarksManager::createBookmark(const BookmarksNode &node)
+{
+	BookmarksItem *bookmark = new BookmarksItem(static_cast<BookmarksItem::BookmarkType>(node.type), (node.url.isEmpty() ? QUrl() : QUrl(node.url)), node.title);
+
+	if (!node.description.isEmpty())
+	{
+		bookmark->setData(node.description, BookmarksModel::DescriptionRole);
+	}
+
+	if (!node.keyword.isEmpty())
+	{
+		bookmark->setData(node.keyword, BookmarksModel::KeywordRole);
+	}
+
+	if (node.timeAdded.isValid())
+	{
+		bookmark->setData(node.timeAdded, BookmarksModel::TimeAddedRole);
+	}
+
+	if (node.timeModified.isValid())
+	{
+		bookmark->setData(node.timeModified, BookmarksModel::TimeModifiedRole);
+	}
+
+	if (!BookmarksItem::m_statistics.contains(QUrl(node.url).toString()))
+	{
+		if (node.timeVisited.isValid())
+		{
+			bookmark->setData(node.timeVisited, BookmarksModel::TimeVisitedRole);
+		}
+
+		if (node.visits > 0)
+		{
+			bookmark->setData(node.visits, BookmarksModel::VisitsRole);
+		}
+	}
+
+	for (int i = 0; i < node.children.count(); ++i)
+	{
+		bookmark->appendRow(createBookmark(node.children.at(i)));
+	}
+
+	return bookmark;
+}
+
+BookmarksSnapshot BookmarksManager::loadBookmarks(const QString &profilePath)
 {
-	if (!m_model && m_instance)
+	BookmarksSnapshot snapshot;
+	const QString path = profilePath + QLatin1String("/bookmarks.xbel");
+	const QString snapshotPath = profilePath + QLatin1String("/bookmarks.cache");
+	const QFileInfo fileInformation(path);
+
+	QFile statisticsFile(profilePath + QLatin1String("/bookmarksStatistics.dat"));
+
+	if (statisticsFile.open(QIODevice::ReadOnly))
 	{
-		QFile file(SessionsManager::getProfilePath() + QLatin1String("/bookmarks.xbel"));
+		QDataStream stream(&statisticsFile);
+		stream.setVersion(QDataStream::Qt_5_2);
+
+		quint32 magic = 0;
+		quint32 version = 0;
+		qint32 amount = 0;
 
-		m_model = new BookmarksModel(m_instance);
+		stream >> magic >> version >> amount;
 
-		if (!file.exists())
+		if (magic == 0x4F425354 && version == 1)
 		{
-			connect(m_model, SIGNAL(rowsInserted(QModelIndex,int,int)), m_instance, SLOT(scheduleSave()));
+			for (qint32 i = 0; i < amount && stream.status() == QDataStream::Ok; ++i)
+			{
+				QString url;
+				qint32 visits = 0;
+				BookmarkStatistics statistics;
 
-			return m_model;
+				stream >> url >> visits >> statistics.timeVisited;
+
+				statistics.visits = visits;
+
+				snapshot.statistics[url] = statistics;
+			}
 		}
+	}
+
+	if (fileInformation.exists() && !readSnapshot(&snapshot.root, path, snapshotPath))
+	{
+		snapshot.root = BookmarksNode();
+
+		QFile file(path);
 
 		if (!file.open(QFile::ReadOnly | QFile::Text))
 		{
-			Console::addMessage(tr("Failed to open bookmarks file: %0").arg(file.errorString()), OtherMessageCategory, ErrorMessageLevel);
+			snapshot.error = file.errorString();
 
-			return m_model;
+			return snapshot;
 		}
 
 		QXmlStreamReader reader(file.readAll());
@@ -407,7 +753,7 @@ BookmarksModel* BookmarksManager::getModel()
 			{
 				if (reader.name() == QLatin1String("folder") || reader.name() == QLatin1String("bookmark") || reader.name() == QLatin1String("separator"))
 				{
-					readBookmark(&reader, m_model->getRootItem());
+					readBookmark(&reader, &snapshot.root);
 				}
 				else
 				{
@@ -416,32 +762,298 @@ BookmarksModel* BookmarksManager::getModel()
 
 				if (reader.hasError())
 				{
-					m_model->clear();
+					snapshot.root = BookmarksNode();
+					snapshot.error = QString::number(reader.error());
+					snapshot.hasParseError = true;
+
+					return snapshot;
+				}
+			}
+		}
+
+		writeSnapshot(snapshot.root, path, snapshotPath);
+	}
+
+	snapshot.isJournalValid = applyJournal(&snapshot.root, path, profilePath + QLatin1String("/bookmarks.journal"), &snapshot.journalEntries);
+
+	return snapshot;
+}
+
+bool BookmarksManager::readSnapshot(BookmarksNode *root, const QString &path, const QString &snapshotPath)
+{
+	const QFileInfo fileInformation(path);
+	QFile file(snapshotPath);
+
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		return false;
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_2);
+
+	quint32 magic = 0;
+	quint32 version = 0;
+	qint64 size = 0;
+	QDateTime lastModified;
+
+	stream >> magic >> version >> size >> lastModified;
+
+	if (magic != 0x4F42534E || version != 1 || size != fileInformation.size() || lastModified != fileInformation.lastModified())
+	{
+		return false;
+	}
+
+	readSnapshotNode(stream, root);
+
+	return (stream.status() == QDataStream::Ok);
+}
+
+bool BookmarksManager::applyJournal(BookmarksNode *root, const QString &path, const QString &journalPath, int *entries)
+{
+	const QFileInfo fileInformation(path);
+	QFile file(journalPath);
+
+	if (!file.exists())
+	{
+		return true;
+	}
+
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		return false;
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_2);
+
+	quint32 magic = 0;
+	quint32 version = 0;
+	qint64 size = 0;
+	QDateTime lastModified;
+
+	stream >> magic >> version >> size >> lastModified;
+
+	if (magic != 0x4F424A4E || version != 1 || size != fileInformation.size() || lastModified != fileInformation.lastModified())
+	{
+		return false;
+	}
+
+	while (!stream.atEnd())
+	{
+		QByteArray record;
+
+		stream >> record;
+
+		if (stream.status() != QDataStream::Ok)
+		{
+			break;
+		}
+
+		QDataStream recordStream(record);
+		recordStream.setVersion(QDataStream::Qt_5_2);
+
+		quint8 operation = 0;
+		QList<int> nodePath;
+
+		recordStream >> operation >> nodePath;
+
+		if (operation == ChangeOperation && nodePath.count() > 1)
+		{
+			const int row = nodePath.takeLast();
+			BookmarksNode *parent = findNode(root, nodePath);
+			BookmarksNode node;
+
+			readSnapshotNode(recordStream, &node);
+
+			if (!parent || row < 0 || row >= parent->children.count() || recordStream.status() != QDataStream::Ok)
+			{
+				return false;
+			}
+
+			node.children = parent->children.at(row).children;
+
+			parent->children[row] = node;
+		}
+		else
+		{
+			BookmarksNode *parent = findNode(root, nodePath);
+			qint32 row = 0;
+
+			recordStream >> row;
+
+			if (!parent || row < 0 || row > parent->children.count())
+			{
+				return false;
+			}
+
+			if (operation == InsertOperation)
+			{
+				BookmarksNode node;
+
+				readSnapshotNode(recordStream, &node);
+
+				if (recordStream.status() != QDataStream::Ok)
+				{
+					return false;
+				}
+
+				parent->children.insert(row, node);
+			}
+			else if (operation == RemoveOperation)
+			{
+				qint32 amount = 0;
 
-					QMessageBox::warning(NULL, tr("Error"), tr("Failed to parse bookmarks file. No bookmarks were loaded."), QMessageBox::Close);
-					Console::addMessage(tr("Failed to load bookmarks file properly, QXmlStreamReader error code: %1").arg(reader.error()), OtherMessageCategory, ErrorMessageLevel);
+				recordStream >> amount;
 
-					return m_model;
+				if (amount < 0 || (row + amount) > parent->children.count())
+				{
+					return false;
+				}
+
+				for (qint32 i = 0; i < amount; ++i)
+				{
+					parent->children.removeAt(row);
 				}
 			}
+			else
+			{
+				return false;
+			}
+		}
+
+		++(*entries);
+	}
+
+	return true;
+}
+
+BookmarksNode* BookmarksManager::findNode(BookmarksNode *root, const QList<int> &path)
+{
+	if (path.isEmpty() || path.first() != 0)
+	{
+		return NULL;
+	}
+
+	BookmarksNode *node = root;
+
+	for (int i = 1; i < path.count(); ++i)
+	{
+		if (path.at(i) < 0 || path.at(i) >= node->children.count())
+		{
+			return NULL;
+		}
+
+		node = &node->children[path.at(i)];
+	}
+
+	return node;
+}
+
+QList<int> BookmarksManager::getPath(const QModelIndex &index)
+{
+	QList<int> path;
+	QModelIndex parent = index;
+
+	while (parent.isValid())
+	{
+		path.prepend(parent.row());
+
+		parent = parent.parent();
+	}
+
+	return path;
+}
+
+void BookmarksManager::writeSnapshot(const BookmarksNode &root, const QString &path, const QString &snapshotPath)
+{
+	const QFileInfo fileInformation(path);
+	QSaveFile file(snapshotPath);
+
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		return;
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_2);
+	stream << quint32(0x4F42534E) << quint32(1) << fileInformation.size() << fileInformation.lastModified();
+
+	writeSnapshotNode(stream, root);
+
+	file.commit();
+}
+
+void BookmarksManager::readSnapshotNode(QDataStream &stream, BookmarksNode *node)
+{
+	qint32 amount = 0;
+
+	stream >> node->type >> node->url >> node->title >> node->description >> node->keyword >> node->timeAdded >> node->timeModified >> node->timeVisited >> node->visits >> amount;
+
+	if (amount < 0 || stream.status() != QDataStream::Ok)
+	{
+		stream.setStatus(QDataStream::ReadCorruptData);
+
+		return;
+	}
+
+	for (qint32 i = 0; i < amount && stream.status() == QDataStream::Ok; ++i)
+	{
+		node->children.append(BookmarksNode());
+
+		readSnapshotNode(stream, &node->children.last());
+	}
+}
+
+BookmarksNode BookmarksManager::getNode(QStandardItem *bookmark)
+{
+	BookmarksNode node;
+	node.type = bookmark->data(BookmarksModel::TypeRole).toInt();
+	node.url = bookmark->data(BookmarksModel::UrlRole).toUrl().toString();
+	node.title = bookmark->data(BookmarksModel::TitleRole).toString();
+	node.description = bookmark->data(BookmarksModel::DescriptionRole).toString();
+	node.keyword = bookmark->data(BookmarksModel::KeywordRole).toString();
+	node.timeAdded = bookmark->data(BookmarksModel::TimeAddedRole).toDateTime();
+	node.timeModified = bookmark->data(BookmarksModel::TimeModifiedRole).toDateTime();
+	node.timeVisited = bookmark->data(BookmarksModel::TimeVisitedRole).toDateTime();
+	node.visits = bookmark->data(BookmarksModel::VisitsRole).toInt();
+
+	for (int i = 0; i < bookmark->rowCount(); ++i)
+	{
+		if (bookmark->child(i, 0))
+		{
+			node.children.append(getNode(bookmark->child(i, 0)));
 		}
+	}
 
-		connect(m_model, SIGNAL(itemChanged(QStandardItem*)), m_instance, SLOT(scheduleSave()));
-		connect(m_model, SIGNAL(rowsInserted(QModelIndex,int,int)), m_instance, SLOT(scheduleSave()));
-		connect(m_model, SIGNAL(rowsRemoved(QModelIndex,int,int)), m_instance, SLOT(scheduleSave()));
-		connect(m_model, SIGNAL(rowsMoved(QModelIndex,int,int,QModelIndex,int)), m_instance, SLOT(scheduleSave()));
+	return node;
+}
 
-		emit m_instance->modelModified();
+void BookmarksManager::writeSnapshotNode(QDataStream &stream, const BookmarksNode &node)
+{
+	stream << node.type << node.url << node.title << node.description << node.keyword << node.timeAdded << node.timeModified << node.timeVisited << node.visits << qint32(node.children.count());
+
+	for (int i = 0; i < node.children.count(); ++i)
+	{
+		writeSnapshotNode(stream, node.children.at(i));
 	}
+}
 
+BookmarksManager* BookmarksManager::getInstance()
+{
+	return m_instance;
+}
+
+BookmarksModel* BookmarksManager::getModel()
+{
 	return m_model;
 }
 
 BookmarksItem* BookmarksManager::getBookmark(const QString &keyword)
 {
-	if (!m_model)
+	if (!m_isLoaded)
 	{
-		getModel();
+		return NULL;
 	}
 
 	return BookmarksItem::getBookmark(keyword);
@@ -449,9 +1061,9 @@ BookmarksItem* BookmarksManager::getBookmark(const QString &keyword)
 
 QStringList BookmarksManager::getKeywords()
 {
-	if (!m_model)
+	if (!m_isLoaded)
 	{
-		getModel();
+		return QStringList();
 	}
 
 	return BookmarksItem::getKeywords();
@@ -459,9 +1071,9 @@ QStringList BookmarksManager::getKeywords()
 
 QStringList BookmarksManager::getUrls()
 {
-	if (!m_model)
+	if (!m_isLoaded)
 	{
-		getModel();
+		return QStringList();
 	}
 
 	return BookmarksItem::getUrls();
@@ -469,9 +1081,9 @@ QStringList BookmarksManager::getUrls()
 
 bool BookmarksManager::hasBookmark(const QString &url)
 {
-	if (!m_model)
+	if (!m_isLoaded)
 	{
-		getModel();
+		return false;
 	}
 
 	return BookmarksItem::hasUrl(url);
@@ -479,16 +1091,26 @@ bool BookmarksManager::hasBookmark(const QString &url)
 
 bool BookmarksManager::hasKeyword(const QString &keyword)
 {
-	if (!m_model)
+	if (!m_isLoaded)
 	{
-		getModel();
+		return false;
 	}
 
 	return BookmarksItem::hasKeyword(keyword);
 }
 
+bool BookmarksManager::isLoaded()
+{
+	return m_isLoaded;
+}
+
 bool BookmarksManager::save(const QString &path)
 {
+	if (!m_isLoaded)
+	{
+		return false;
+	}
+
 	QFile file(path.isEmpty() ? SessionsManager::getProfilePath() + QLatin1String("/bookmarks.xbel") : path);
 
 	if (!file.open(QFile::WriteOnly))
@@ -511,6 +1133,20 @@ bool BookmarksManager::save(const QString &path)
 
 	writer.writeEndDocument();
 
+	if (path.isEmpty())
+	{
+		file.close();
+
+		writeSnapshot(getNode(m_model->getRootItem()), file.fileName(), SessionsManager::getProfilePath() + QLatin1String("/bookmarks.cache"));
+
+		QFile::remove(SessionsManager::getProfilePath() + QLatin1String("/bookmarks.journal"));
+
+		if (m_instance)
+		{
+			m_instance->m_journalEntries = 0;
+		}
+	}
+
 	return true;
 }
 
@@ -22,6 +22,8 @@
 #define OTTER_BOOKMARKSMANAGER_H
 
 #include <QtCore/QDateTime>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QHash>
 #include <QtCore/QXmlStreamReader>
 #include <QtCore/QXmlStreamWriter>
 #include <QtGui/QStandardItemModel>
@@ -32,6 +34,42 @@ namespace Otter
 class BookmarksItem;
 class BookmarksModel;
 
+struct BookmarksNode
+{
+	QList<BookmarksNode> children;
+	QString url;
+	QString title;
+	QString description;
+	QString keyword;
+	QDateTime timeAdded;
+	QDateTime timeModified;
+	QDateTime timeVisited;
+	int visits;
+	int type;
+
+	BookmarksNode() : visits(0), type(0) {}
+};
+
+struct BookmarkStatistics
+{
+	QDateTime timeVisited;
+	int visits;
+
+	BookmarkStatistics() : visits(0) {}
+};
+
+struct BookmarksSnapshot
+{
+	BookmarksNode root;
+	QHash<QString, BookmarkStatistics> statistics;
+	QString error;
+	int journalEntries;
+	bool isJournalValid;
+	bool hasParseError;
+
+	BookmarksSnapshot() : journalEntries(0), isJournalValid(true), hasParseError(false) {}
+};
+
 class BookmarksManager : public QObject
 {
 	Q_OBJECT
@@ -47,23 +85,54 @@ public:
 	static QStringList getUrls();
 	static bool hasBookmark(const QString &url);
 	static bool hasKeyword(const QString &keyword);
+	static bool isLoaded();
 	static bool save(const QString &path = QString());
 
 protected:
+	enum JournalOperation
+	{
+		InsertOperation = 1,
+		RemoveOperation = 2,
+		ChangeOperation = 3
+	};
+
 	explicit BookmarksManager(QObject *parent = NULL);
+	~BookmarksManager();
 
 	void timerEvent(QTimerEvent *event);
-	static void readBookmark(QXmlStreamReader *reader, BookmarksItem *parent);
+	void appendJournal(const QByteArray &record);
+	void scheduleStatisticsSave();
+	static void saveStatistics();
+	static void readBookmark(QXmlStreamReader *reader, BookmarksNode *parent);
 	static void writeBookmark(QXmlStreamWriter *writer, QStandardItem *bookmark);
+	static void readSnapshotNode(QDataStream &stream, BookmarksNode *node);
+	static void writeSnapshotNode(QDataStream &stream, const BookmarksNode &node);
+	static void writeSnapshot(const BookmarksNode &root, const QString &path, const QString &snapshotPath);
+	static BookmarksNode getNode(QStandardItem *bookmark);
+	static BookmarksNode* findNode(BookmarksNode *root, const QList<int> &path);
+	static BookmarksItem* createBookmark(const BookmarksNode &node);
+	static BookmarksSnapshot loadBookmarks(const QString &profilePath);
+	static QList<int> getPath(const QModelIndex &index);
+	static bool readSnapshot(BookmarksNode *root, const QString &path, const QString &snapshotPath);
+	static bool applyJournal(BookmarksNode *root, const QString &path, const QString &journalPath, int *entries);
 
 protected slots:
 	void scheduleSave();
+	void bookmarksLoaded();
+	void journalInsert(const QModelIndex &parent, int first, int last);
+	void journalRemove(const QModelIndex &parent, int first, int last);
+	void journalChange(QStandardItem *bookmark);
 
 private:
+	QFutureWatcher<BookmarksSnapshot> m_loadWatcher;
+	int m_journalEntries;
 	int m_saveTimer;
+	int m_statisticsTimer;
 
 	static BookmarksManager *m_instance;
 	static BookmarksModel* m_model;
+	static bool m_isLoaded;
+	static bool m_isPopulating;
 
 signals:
 	void modelModified();
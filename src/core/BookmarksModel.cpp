@@ -29,6 +29,7 @@ namespace Otter
 
 QHash<QString, QList<BookmarksItem*> > BookmarksItem::m_urls;
 QHash<QString, BookmarksItem*> BookmarksItem::m_keywords;
+QHash<QString, BookmarkStatistics> BookmarksItem::m_statistics;
 
 BookmarksItem::BookmarksItem(BookmarkType type, const QUrl &url, const QString &title) : QStandardItem()
 {
@@ -66,6 +67,7 @@ BookmarksItem::~BookmarksItem()
 			if (m_urls[url].isEmpty())
 			{
 				m_urls.remove(url);
+				m_statistics.remove(url);
 			}
 		}
 	}
@@ -78,6 +80,42 @@ BookmarksItem::~BookmarksItem()
 
 void BookmarksItem::setData(const QVariant &value, int role)
 {
+	if ((role == BookmarksModel::VisitsRole || role == BookmarksModel::TimeVisitedRole) && !data(BookmarksModel::UrlRole).toUrl().isEmpty())
+	{
+		if (!value.isValid())
+		{
+			return;
+		}
+
+		const QString url = data(BookmarksModel::UrlRole).toUrl().toString();
+		BookmarkStatistics &statistics = m_statistics[url];
+
+		if (role == BookmarksModel::VisitsRole)
+		{
+			statistics.visits = value.toInt();
+		}
+		else
+		{
+			statistics.timeVisited = value.toDateTime();
+		}
+
+		const QList<BookmarksItem*> bookmarks = m_urls.value(url);
+
+		for (int i = 0; i < bookmarks.count(); ++i)
+		{
+			QStandardItemModel *model = bookmarks.at(i)->model();
+
+			if (model)
+			{
+				const QModelIndex index = bookmarks.at(i)->index();
+
+				emit model->dataChanged(index, index);
+			}
+		}
+
+		return;
+	}
+
 	if (role == BookmarksModel::UrlRole && value.toUrl() != data(BookmarksModel::UrlRole).toUrl())
 	{
 		const QString oldUrl = data(BookmarksModel::UrlRole).toUrl().toString();
@@ -90,6 +128,7 @@ void BookmarksItem::setData(const QVariant &value, int role)
 			if (m_urls[oldUrl].isEmpty())
 			{
 				m_urls.remove(oldUrl);
+				m_statistics.remove(oldUrl);
 			}
 		}
 
@@ -192,6 +231,23 @@ QVariant BookmarksItem::data(int role) const
 		return QLatin1String("separator");
 	}
 
+	if ((role == BookmarksModel::VisitsRole || role == BookmarksModel::TimeVisitedRole) && !data(BookmarksModel::UrlRole).toUrl().isEmpty())
+	{
+		const QString url = data(BookmarksModel::UrlRole).toUrl().toString();
+
+		if (!m_statistics.contains(url))
+		{
+			return QVariant();
+		}
+
+		if (role == BookmarksModel::VisitsRole)
+		{
+			return m_statistics[url].visits;
+		}
+
+		return m_statistics[url].timeVisited;
+	}
+
 	return QStandardItem::data(role);
 }
 
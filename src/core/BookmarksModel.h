@@ -60,6 +60,7 @@ protected:
 private:
 	static QHash<QString, QList<BookmarksItem*> > m_urls;
 	static QHash<QString, BookmarksItem*> m_keywords;
+	static QHash<QString, BookmarkStatistics> m_statistics;
 
 	friend class BookmarksManager;
 	friend class BookmarkPropertiesDialog;
@@ -76,4 +76,9 @@ QList<ConsoleMessage*> Console::getMessages()
 	return m_messages;
 }
 
+bool Console::hasListeners()
+{
+	return (m_instance && m_instance->receivers(SIGNAL(messageAdded(ConsoleMessage*))) > 0);
+}
+
 }
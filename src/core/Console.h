@@ -64,6 +64,7 @@ public:
 	static void addMessage(const QString &note, MessageCategory category, MessageLevel level, const QString &source = QString(), int line = -1, qint64 window = -1);
 	static Console* getInstance();
 	static QList<ConsoleMessage*> getMessages();
+	static bool hasListeners();
 
 protected:
 	explicit Console(QObject *parent = NULL);
@@ -20,12 +20,20 @@
 
 #include "ContentBlockingList.h"
 #include "Console.h"
-#include "ContentBlockingManager.h"
+#include "ContentBlockingMatcher.h"
+#include "SessionsManager.h"
 
 #include <QtConcurrent/QtConcurrentRun>
 #include <QtCore/QCoreApplication>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
 #include <QtCore/QDir>
+#include <QtCore/QSaveFile>
+#include <QtCore/QSettings>
 #include <QtCore/QTextStream>
+#include <QtCore/QTimer>
+#include <QtCore/QTimerEvent>
+#include <QtCore/QtAlgorithms>
 #include <QtNetwork/QNetworkReply>
 #include <QtNetwork/QNetworkRequest>
 
@@ -33,14 +41,43 @@ namespace Otter
 {
 
 NetworkManager* ContentBlockingList::m_networkManager = NULL;
+int ContentBlockingList::m_scheduledUpdates = 0;
 
 ContentBlockingList::ContentBlockingList(QObject *parent) : QObject(parent),
-	m_root(NULL),
 	m_networkReply(NULL),
+	m_domainExpression(QLatin1String("[:\?&/=]")),
+	m_lookups(0),
+	m_hits(0),
+	m_generation(0),
 	m_daysToExpire(4),
+	m_checkTimer(0),
+	m_isEmpty(true),
 	m_isUpdated(false),
 	m_isEnabled(false)
 {
+	m_checkTimer = startTimer(3600000);
+
+	connect(&m_updateWatcher, SIGNAL(finished()), this, SLOT(updateInstalled()));
+}
+
+void ContentBlockingList::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() != m_checkTimer || !m_isEnabled || m_isUpdated || !m_updateUrl.isValid())
+	{
+		return;
+	}
+
+	QDateTime lastCheck = getUpdateOption(QLatin1String("lastCheck")).toDateTime();
+
+	if (m_lastUpdate.isValid() && (!lastCheck.isValid() || lastCheck < m_lastUpdate))
+	{
+		lastCheck = m_lastUpdate;
+	}
+
+	if (!lastCheck.isValid() || lastCheck.daysTo(QDateTime::currentDateTimeUtc()) > m_daysToExpire)
+	{
+		scheduleUpdate(m_isEmpty);
+	}
 }
 
 void ContentBlockingList::parseRules()
@@ -55,9 +92,68 @@ void ContentBlockingList::parseRules()
 		return;
 	}
 
-	QTextStream adFileStream(&rulesFile);
+	if (!parseHeader(&rulesFile, isFileEmpty))
+	{
+		Console::addMessage(QCoreApplication::translate("main", "Loaded adblock file is not valid: %0").arg(rulesFile.fileName()), Otter::OtherMessageCategory, ErrorMessageLevel);
+
+		return;
+	}
+
+	QDateTime lastCheck = getUpdateOption(QLatin1String("lastCheck")).toDateTime();
+
+	if (m_lastUpdate.isValid() && (!lastCheck.isValid() || lastCheck < m_lastUpdate))
+	{
+		lastCheck = m_lastUpdate;
+	}
+
+	if ((isFileEmpty && m_updateUrl.isValid()) || (lastCheck.isValid() && lastCheck.daysTo(QDateTime::currentDateTimeUtc()) > m_daysToExpire))
+	{
+		scheduleUpdate(isFileEmpty);
+	}
+
+	m_isEmpty = isFileEmpty;
+
+	rulesFile.seek(0);
+
+	QCryptographicHash hash(QCryptographicHash::Md5);
+
+	while (!rulesFile.atEnd())
+	{
+		hash.addData(rulesFile.read(65536));
+	}
+
+	rulesFile.close();
+
+	const QByteArray checksum = hash.result();
+	int generation = 0;
+
+	m_matcherMutex.lock();
+
+	generation = m_generation;
+
+	m_matcherMutex.unlock();
+
+	m_isEnabled = true;
+
+	ContentBlockingMatcher *matcher = ContentBlockingMatcher::load(m_fullFilePath + QLatin1String(".cache"), checksum);
+
+	if (matcher)
+	{
+		setMatcher(matcher, generation);
+
+		return;
+	}
+
+	QtConcurrent::run(this, &ContentBlockingList::loadRuleFile, checksum, generation);
+}
+
+bool ContentBlockingList::parseHeader(QIODevice *device, bool &isFileEmpty)
+{
+	QTextStream adFileStream(device);
 	const QString fileHeader = adFileStream.readLine().trimmed();
 
+	isFileEmpty = true;
+
 	while (!adFileStream.atEnd())
 	{
 		QString headerLine = adFileStream.readLine();
@@ -87,30 +183,11 @@ void ContentBlockingList::parseRules()
 		}
 	}
 
-	if (!fileHeader.startsWith(QLatin1String("[Adblock Plus 2.")))
-	{
-		Console::addMessage(QCoreApplication::translate("main", "Loaded adblock file is not valid: %0").arg(rulesFile.fileName()), Otter::OtherMessageCategory, ErrorMessageLevel);
-
-		return;
-	}
-	else if ((isFileEmpty && m_updateUrl.isValid()) || (m_lastUpdate.isValid() && m_lastUpdate.daysTo(QDateTime::currentDateTimeUtc()) > m_daysToExpire))
-	{
-		if (!m_isUpdated)
-		{
-			downloadUpdate();
-		}
-	}
-
-	rulesFile.close();
-
-	QtConcurrent::run(this, &ContentBlockingList::loadRuleFile);
+	return fileHeader.startsWith(QLatin1String("[Adblock Plus 2."));
 }
 
-void ContentBlockingList::loadRuleFile()
+void ContentBlockingList::loadRuleFile(const QByteArray &checksum, int generation)
 {
-	m_root = new Node();
-	m_domainExpression = QRegularExpression(QLatin1String("[:\?&/=]"));
-
 	QFile rulesFile(m_fullFilePath);
 
 	rulesFile.open(QIODevice::ReadOnly | QIODevice::Text);
@@ -119,50 +196,64 @@ void ContentBlockingList::loadRuleFile()
 
 	adFileStream.readLine(); // header
 
+	QVector<ContentBlockingRule> rules;
+	QStringList cssHidingRules;
+	QMultiHash<QString, QString> cssSpecificDomainHidingRules;
+	QMultiHash<QString, QString> cssHidingRulesExceptions;
+	int skippedRulesAmount = 0;
+
 	while (!adFileStream.atEnd())
 	{
-		parseRuleLine(adFileStream.readLine());
+		if (!parseRuleLine(adFileStream.readLine(), rules, cssHidingRules, cssSpecificDomainHidingRules, cssHidingRulesExceptions))
+		{
+			++skippedRulesAmount;
+		}
 	}
 
-	if (m_cssHidingRules.length() > 0)
-	{
-		m_cssHidingRules = m_cssHidingRules.left(m_cssHidingRules.length() - 1);
-		m_cssHidingRules += QLatin1String("{display:none;}");
-	}
+	rulesFile.close();
 
-	m_isEnabled = true;
+	QByteArray cosmeticData;
+	QDataStream stream(&cosmeticData, QIODevice::WriteOnly);
+	stream << cssHidingRules << cssSpecificDomainHidingRules << cssHidingRulesExceptions;
 
-	emit updateCustomStyleSheets();
+	ContentBlockingMatcher *matcher = new ContentBlockingMatcher(ContentBlockingMatcher::compile(rules, checksum, cosmeticData, skippedRulesAmount));
 
-	rulesFile.close();
+	rules.clear();
+
+	if (!matcher->save(m_fullFilePath + QLatin1String(".cache")))
+	{
+		QFile::remove(m_fullFilePath + QLatin1String(".cache"));
+	}
+
+	setMatcher(matcher, generation);
 }
 
-void ContentBlockingList::parseRuleLine(QString line)
+bool ContentBlockingList::parseRuleLine(QString line, QVector<ContentBlockingRule> &rules, QStringList &cssHidingRules, QMultiHash<QString, QString> &cssSpecificDomainHidingRules, QMultiHash<QString, QString> &cssHidingRulesExceptions) const
 {
 	if (line.indexOf(QLatin1Char('!')) == 0 || line.isEmpty())
 	{
-		return;
+		return true;
 	}
 
 	if (line.startsWith(QLatin1String("##")))
 	{
-		m_cssHidingRules += line.mid(2) + QLatin1Char(',');
+		cssHidingRules.append(line.mid(2));
 
-		return;
+		return true;
 	}
 
 	if (line.contains(QLatin1String("##")))
 	{
-		parseCssRule(line.split(QLatin1String("##")), m_cssSpecificDomainHidingRules);
+		parseCssRule(line.split(QLatin1String("##")), cssSpecificDomainHidingRules);
 
-		return;
+		return true;
 	}
 
 	if (line.contains(QLatin1String("#@#")))
 	{
-		parseCssRule(line.split(QLatin1String("#@#")), m_cssHidingRulesExceptions);
+		parseCssRule(line.split(QLatin1String("#@#")), cssHidingRulesExceptions);
 
-		return;
+		return true;
 	}
 
 	const int optionSeparator = line.indexOf(QLatin1Char('$'));
@@ -175,93 +266,96 @@ void ContentBlockingList::parseRuleLine(QString line)
 		line = line.left(optionSeparator);
 	}
 
-	while (line.endsWith(QLatin1Char('|')) || line.endsWith(QLatin1Char('*')) || line.endsWith(QLatin1Char('^')))
-	{
-		line = line.left(line.length() - 1);
-	}
+	ContentBlockingRule rule;
+
+	line = line.toLower();
 
-	if (line.startsWith(QLatin1Char('*')))
+	if (line.startsWith(QLatin1String("@@")))
 	{
-		line = line.mid(1);
+		line = line.mid(2);
+
+		rule.isException = true;
 	}
 
-	if (line.contains(QLatin1Char('*')) || line.contains(QLatin1Char('^')))
+	if (line.startsWith(QLatin1String("||")))
 	{
-		// TODO
-		return;
+		line = line.mid(2);
+
+		rule.needsDomainCheck = true;
 	}
+	else if (line.startsWith(QLatin1Char('|')))
+	{
+		line = line.mid(1);
 
-	ContentBlockingRule *rule = new ContentBlockingRule();
-	rule->ruleOption = NoOption;
-	rule->exceptionRuleOption = NoOption;
-	rule->isException = false;
-	rule->needsDomainCheck = false;
+		rule.isStartAnchored = true;
+	}
 
-	if (line.startsWith(QLatin1String("@@")))
+	if (line.endsWith(QLatin1Char('|')))
 	{
-		line = line.mid(2);
+		line = line.left(line.length() - 1);
 
-		rule->isException = true;
+		rule.isEndAnchored = true;
 	}
 
-	if (line.startsWith(QLatin1String("||")))
+	while (line.endsWith(QLatin1Char('*')) && !rule.isEndAnchored)
 	{
-		line = line.mid(2);
+		line = line.left(line.length() - 1);
+	}
 
-		rule->needsDomainCheck = true;
+	while (line.startsWith(QLatin1Char('*')) && !rule.needsDomainCheck && !rule.isStartAnchored)
+	{
+		line = line.mid(1);
 	}
 
+	rule.isLiteral = !(rule.isStartAnchored || rule.isEndAnchored || line.contains(QLatin1Char('*')) || line.contains(QLatin1Char('^')));
+
 	for (int i = 0; i < options.count(); ++i)
 	{
 		const bool optionException = options.at(i).startsWith(QLatin1Char('~'));
 
 		if (options.at(i).contains(QLatin1String("third-party")))
 		{
-			rule->ruleOption |= ThirdPartyOption;
-			rule->exceptionRuleOption |= (optionException ? ThirdPartyOption : NoOption);
+			rule.ruleOption |= ThirdPartyOption;
+			rule.exceptionRuleOption |= (optionException ? ThirdPartyOption : NoOption);
 		}
 		else if (options.at(i).contains(QLatin1String("stylesheet")))
 		{
-			rule->ruleOption |= StyleSheetOption;
-			rule->exceptionRuleOption |= (optionException ? StyleSheetOption : NoOption);
+			rule.ruleOption |= StyleSheetOption;
+			rule.exceptionRuleOption |= (optionException ? StyleSheetOption : NoOption);
 		}
 		else if (options.at(i).contains(QLatin1String("image")))
 		{
-			rule->ruleOption |= ImageOption;
-			rule->exceptionRuleOption |= (optionException ? ImageOption : NoOption);
+			rule.ruleOption |= ImageOption;
+			rule.exceptionRuleOption |= (optionException ? ImageOption : NoOption);
 		}
 		else if (options.at(i).contains(QLatin1String("script")))
 		{
-			rule->ruleOption |= ScriptOption;
-			rule->exceptionRuleOption |= (optionException ? ScriptOption : NoOption);
+			rule.ruleOption |= ScriptOption;
+			rule.exceptionRuleOption |= (optionException ? ScriptOption : NoOption);
 		}
 		else if (options.at(i).contains(QLatin1String("object")))
 		{
-			rule->ruleOption |= ObjectOption;
-			rule->exceptionRuleOption |= (optionException ? ObjectOption : NoOption);
+			rule.ruleOption |= ObjectOption;
+			rule.exceptionRuleOption |= (optionException ? ObjectOption : NoOption);
 		}
 		else if (options.at(i).contains(QLatin1String("object-subrequest")) || options.at(i).contains(QLatin1String("object_subrequest")))
 		{
-			rule->ruleOption |= ObjectSubRequestOption;
-			rule->exceptionRuleOption |= (optionException ? ObjectSubRequestOption : NoOption);
+			rule.ruleOption |= ObjectSubRequestOption;
+			rule.exceptionRuleOption |= (optionException ? ObjectSubRequestOption : NoOption);
 			// TODO
-			delete rule;
-
-			return;
+			return false;
 		}
 		else if (options.at(i).contains(QLatin1String("subdocument")))
 		{
-			rule->ruleOption |= SubDocumentOption;
-			rule->exceptionRuleOption |= (optionException ? SubDocumentOption : NoOption);
+			rule.ruleOption |= SubDocumentOption;
+			rule.exceptionRuleOption |= (optionException ? SubDocumentOption : NoOption);
 			// TODO
-			delete rule;
-
-			return;
+			return false;
 		}
 		else if (options.at(i).contains(QLatin1String("xmlhttprequest")))
 		{
-			rule->ruleOption |= XmlHttpRequestOption;
-			rule->exceptionRuleOption |= (optionException ? XmlHttpRequestOption : NoOption);
+			rule.ruleOption |= XmlHttpRequestOption;
+			rule.exceptionRuleOption |= (optionException ? XmlHttpRequestOption : NoOption);
 		}
 		else if (options.at(i).contains(QLatin1String("domain")))
 		{
@@ -271,29 +365,34 @@ void ContentBlockingList::parseRuleLine(QString line)
 			{
 				if (parsedDomains.at(j).startsWith(QLatin1Char('~')))
 				{
-					rule->allowedDomains.append(parsedDomains.at(j).mid(1));
+					rule.allowedDomains.append(parsedDomains.at(j).mid(1));
 
 					continue;
 				}
 
-				rule->blockedDomains.append(parsedDomains.at(j));
+				rule.blockedDomains.append(parsedDomains.at(j));
 			}
 		}
 		else
 		{
 			// TODO - document, elemhide
-			delete rule;
-
-			return;
+			return false;
 		}
 	}
 
-	addRule(rule, line);
+	rule.pattern = line;
 
-	return;
+	if (rule.needsDomainCheck && rule.isLiteral)
+	{
+		rule.domain = line.left(line.indexOf(m_domainExpression));
+	}
+
+	rules.append(rule);
+
+	return true;
 }
 
-void ContentBlockingList::parseCssRule(const QStringList &line, QMultiHash<QString, QString> &list)
+void ContentBlockingList::parseCssRule(const QStringList &line, QMultiHash<QString, QString> &list) const
 {
 	const QStringList domains = line.at(0).split(QLatin1Char(','));
 
@@ -303,98 +402,6 @@ void ContentBlockingList::parseCssRule(const QStringList &line, QMultiHash<QStri
 	}
 }
 
-void ContentBlockingList::resolveRuleOptions(ContentBlockingRule *rule, const QNetworkRequest &request, bool &isBlocked)
-{
-	const QString url = request.url().url();
-	const QByteArray requestHeader = request.rawHeader(QByteArray("Accept"));
-	const QString baseUrlHost = m_baseUrl.host();
-
-	isBlocked = ((rule->allowedDomains.count() > 0) ? !resolveDomainExceptions(baseUrlHost, rule->allowedDomains) : isBlocked);
-	isBlocked = ((rule->blockedDomains.count() > 0) ? resolveDomainExceptions(baseUrlHost, rule->blockedDomains) : isBlocked);
-
-	if (rule->ruleOption & ThirdPartyOption)
-	{
-		if (baseUrlHost.isEmpty() || m_requestSubdomainList.contains(baseUrlHost))
-		{
-			isBlocked = (rule->exceptionRuleOption & ThirdPartyOption);
-		}
-		else
-		{
-			isBlocked = !(rule->exceptionRuleOption & ThirdPartyOption);
-		}
-	}
-
-	if (rule->ruleOption & ImageOption)
-	{
-		if (requestHeader.contains(QByteArray("image/")) || url.endsWith(QLatin1String(".png")) || url.endsWith(QLatin1String(".jpg")) || url.endsWith(QLatin1String(".gif")))
-		{
-			isBlocked = (isBlocked ? !(rule->exceptionRuleOption & ImageOption) : isBlocked);
-		}
-		else
-		{
-			isBlocked = (isBlocked ? (rule->exceptionRuleOption & ImageOption) : isBlocked);
-		}
-	}
-
-	if (rule->ruleOption & ScriptOption)
-	{
-		if (requestHeader.contains(QByteArray("script/")) || url.endsWith(QLatin1String(".js")))
-		{
-			isBlocked = (isBlocked ? !(rule->exceptionRuleOption & ScriptOption) : isBlocked);
-		}
-		else
-		{
-			isBlocked = (isBlocked ? (rule->exceptionRuleOption & ScriptOption) : isBlocked);
-		}
-	}
-
-	if (rule->ruleOption & StyleSheetOption)
-	{
-		if (requestHeader.contains(QByteArray("text/css")) || url.endsWith(QLatin1String(".css")))
-		{
-			isBlocked = (isBlocked ? !(rule->exceptionRuleOption & StyleSheetOption) : isBlocked);
-		}
-		else
-		{
-			isBlocked = (isBlocked ? (rule->exceptionRuleOption & StyleSheetOption) : isBlocked);
-		}
-	}
-
-	if (rule->ruleOption & ObjectOption)
-	{
-		if (requestHeader.contains(QByteArray("object")))
-		{
-			isBlocked = (isBlocked ? !(rule->exceptionRuleOption & ObjectOption) : isBlocked);
-		}
-		else
-		{
-			isBlocked = (isBlocked ? (rule->exceptionRuleOption & ObjectOption) : isBlocked);
-		}
-	}
-
-	if (rule->ruleOption & SubDocumentOption)
-	{
-		// TODO
-	}
-
-	if (rule->ruleOption & ObjectSubRequestOption)
-	{
-		// TODO
-	}
-
-	if (rule->ruleOption & XmlHttpRequestOption)
-	{
-		if (request.rawHeader(QByteArray("X-Requested-With")) == QByteArray("XMLHttpRequest"))
-		{
-			isBlocked = (isBlocked ? !(rule->exceptionRuleOption & XmlHttpRequestOption) : isBlocked);
-		}
-		else
-		{
-			isBlocked = (isBlocked ? (rule->exceptionRuleOption & XmlHttpRequestOption) : isBlocked);
-		}
-	}
-}
-
 void ContentBlockingList::setFile(const QString &path, const QString &name)
 {
 	m_fileName = name;
@@ -415,66 +422,99 @@ void ContentBlockingList::setEnabled(const bool enabled)
 	}
 }
 
-void ContentBlockingList::addRule(ContentBlockingRule *rule, const QString ruleString)
+void ContentBlockingList::scheduleUpdate(bool isUrgent)
+{
+	if (m_isUpdated)
+	{
+		return;
+	}
+
+	m_isUpdated = true;
+
+	QTimer::singleShot(((isUrgent ? 1000 : 60000) + (m_scheduledUpdates * 15000)), this, SLOT(downloadUpdate()));
+
+	++m_scheduledUpdates;
+}
+
+void ContentBlockingList::downloadUpdate()
 {
-	Node *node = m_root;
+	m_scheduledUpdates = qMax(0, (m_scheduledUpdates - 1));
 
-	for (int i = 0; i < ruleString.length(); ++i)
+	if (!m_networkManager)
 	{
-		const QChar value = ruleString.at(i);
-		bool childrenExists = false;
+		m_networkManager = new NetworkManager(true, QCoreApplication::instance());
+	}
 
-		for (int j = 0; j < node->children.count(); ++j)
-		{
-			Node *nextNode = node->children.at(j);
+	connect(m_networkManager, SIGNAL(finished(QNetworkReply*)), this, SLOT(updateDownloaded(QNetworkReply*)), Qt::UniqueConnection);
 
-			if (nextNode->value == value)
-			{
-				node = nextNode;
+	QNetworkRequest request(m_updateUrl);
+	request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
 
-				childrenExists = true;
+	if (!m_isEmpty)
+	{
+		const QByteArray entityTag = getUpdateOption(QLatin1String("entityTag")).toByteArray();
+		const QByteArray lastModified = getUpdateOption(QLatin1String("lastModified")).toByteArray();
 
-				break;
-			}
+		if (!entityTag.isEmpty())
+		{
+			request.setRawHeader(QByteArray("If-None-Match"), entityTag);
 		}
 
-		if (!childrenExists)
+		if (!lastModified.isEmpty())
 		{
-			Node *newNode = new Node;
-			newNode->value = value;
-
-			node->children.append(newNode);
-
-			node = newNode;
+			request.setRawHeader(QByteArray("If-Modified-Since"), lastModified);
 		}
 	}
 
-	node->rule = rule;
+	m_networkReply = m_networkManager->get(request);
 }
 
-void ContentBlockingList::deleteNode(Node *node)
+int ContentBlockingList::installUpdate(const QByteArray &header, const QByteArray &checksum, const QByteArray &data, const QUrl &url, int generation)
 {
-	for (int j = 0; j < node->children.count(); ++j)
+	if (checksum.contains(QByteArray("! Checksum: ")))
 	{
-		deleteNode(node->children.at(j));
+		QByteArray expectedChecksum = checksum;
+
+		if (QCryptographicHash::hash(header + data, QCryptographicHash::Md5).toBase64().replace(QByteArray("="), QByteArray()) != expectedChecksum.replace(QByteArray("! Checksum: "), QByteArray()).replace(QByteArray("\n"), QByteArray()))
+		{
+			return ChecksumMismatchResult;
+		}
 	}
 
-	delete node->rule;
-	delete node;
-}
+	QByteArray content = header;
+	content.append(QString("! URL: %0\n").arg(url.toString()).toUtf8());
+	content.append(checksum);
 
-void ContentBlockingList::downloadUpdate()
-{
-	if (!m_networkManager)
+	if (!data.contains(QByteArray("! Last modified: ")))
 	{
-		m_networkManager = new NetworkManager(true, QCoreApplication::instance());
+		content.append(QString("! Last modified: " + QLocale(QLatin1String("UnitedStates")).toString(QDateTime::currentDateTimeUtc(), QLatin1String("dd MMM yyyy hh:mm")) + " UTC\n").toUtf8());
 	}
 
-	connect(m_networkManager, SIGNAL(finished(QNetworkReply*)), this, SLOT(updateDownloaded(QNetworkReply*)));
+	content.append(data);
 
-	QNetworkRequest request(m_updateUrl);
+	QSaveFile ruleFile(m_fullFilePath);
 
-	m_networkReply = m_networkManager->get(request);
+	if (!ruleFile.open(QIODevice::WriteOnly) || ruleFile.write(content) != content.size() || !ruleFile.commit())
+	{
+		return WriteFailedResult;
+	}
+
+	m_matcherMutex.lock();
+
+	if (generation != m_generation)
+	{
+		m_matcherMutex.unlock();
+
+		return SucceededResult;
+	}
+
+	const int installedGeneration = ++m_generation;
+
+	m_matcherMutex.unlock();
+
+	loadRuleFile(QCryptographicHash::hash(content, QCryptographicHash::Md5), installedGeneration);
+
+	return SucceededResult;
 }
 
 void ContentBlockingList::updateDownloaded(QNetworkReply *reply)
@@ -484,75 +524,136 @@ void ContentBlockingList::updateDownloaded(QNetworkReply *reply)
 		return;
 	}
 
+	m_networkReply = NULL;
+
+	reply->deleteLater();
+
+	if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304)
+	{
+		m_isUpdated = false;
+
+		setUpdateOption(QLatin1String("lastCheck"), QDateTime::currentDateTimeUtc());
+
+		return;
+	}
+
 	const QByteArray downloadedDataHeader = reply->readLine();
 	const QByteArray downloadedDataChecksum = reply->readLine();
-	const QByteArray downloadedData = reply->readAll();
 
 	if (reply->error() != QNetworkReply::NoError || !downloadedDataHeader.trimmed().startsWith(QByteArray("[Adblock Plus 2.")))
 	{
 		Console::addMessage(QCoreApplication::translate("main", "Unable to download update for content blocking: %0.\nError: %1").arg(m_fullFilePath).arg(reply->errorString()), Otter::OtherMessageCategory, ErrorMessageLevel);
 
-		reply->deleteLater();
+		m_isUpdated = false;
 
 		return;
 	}
 
-	reply->deleteLater();
-
-	if (downloadedDataChecksum.contains(QByteArray("! Checksum: ")))
+	if (m_updateWatcher.isRunning())
 	{
-		QByteArray checksum = downloadedDataChecksum;
+		m_isUpdated = false;
 
-		if (QCryptographicHash::hash(downloadedDataHeader + downloadedData, QCryptographicHash::Md5).toBase64().replace(QByteArray("="), QByteArray()) != checksum.replace(QByteArray("! Checksum: "), QByteArray()).replace(QByteArray("\n"), QByteArray()))
-		{
-			Console::addMessage(QCoreApplication::translate("main", "Content blocking file checksum mismatch: %0").arg(m_fullFilePath), Otter::OtherMessageCategory, ErrorMessageLevel);
+		scheduleUpdate(false);
 
-			return;
-		}
+		return;
 	}
 
-	QFile ruleFile(m_fullFilePath);
+	m_entityTag = reply->rawHeader(QByteArray("ETag"));
+	m_lastModified = reply->rawHeader(QByteArray("Last-Modified"));
+
+	m_matcherMutex.lock();
+
+	const int generation = m_generation;
+
+	m_matcherMutex.unlock();
+
+	m_updateWatcher.setFuture(QtConcurrent::run(this, &ContentBlockingList::installUpdate, downloadedDataHeader, downloadedDataChecksum, reply->readAll(), m_updateUrl, generation));
+}
+
+void ContentBlockingList::updateInstalled()
+{
+	const int result = m_updateWatcher.result();
+
+	m_isUpdated = false;
 
-	if (!ruleFile.open(QFile::ReadWrite | QFile::Truncate))
+	if (result == ChecksumMismatchResult)
 	{
-		Console::addMessage(QCoreApplication::translate("main", "Unable to write downloaded content blocking file: %0").arg(m_fullFilePath), Otter::OtherMessageCategory, ErrorMessageLevel);
+		Console::addMessage(QCoreApplication::translate("main", "Content blocking file checksum mismatch: %0").arg(m_fullFilePath), Otter::OtherMessageCategory, ErrorMessageLevel);
 
 		return;
 	}
 
-	ruleFile.write(downloadedDataHeader);
-	ruleFile.write(QString("! URL: %0\n").arg(m_updateUrl.toString()).toUtf8());
-	ruleFile.write(downloadedDataChecksum);
-
-	if (!downloadedData.contains(QByteArray("! Last modified: ")))
+	if (result == WriteFailedResult)
 	{
-		ruleFile.write(QString("! Last modified: " + QLocale(QLatin1String("UnitedStates")).toString(QDateTime::currentDateTimeUtc(), QLatin1String("dd MMM yyyy hh:mm")) + " UTC\n").toUtf8());
+		Console::addMessage(QCoreApplication::translate("main", "Unable to write downloaded content blocking file: %0").arg(m_fullFilePath), Otter::OtherMessageCategory, ErrorMessageLevel);
+
+		return;
 	}
 
-	ruleFile.write(downloadedData);
-	ruleFile.close();
+	setUpdateOption(QLatin1String("entityTag"), m_entityTag);
+	setUpdateOption(QLatin1String("lastModified"), m_lastModified);
+	setUpdateOption(QLatin1String("lastCheck"), QDateTime::currentDateTimeUtc());
 
-	if (ruleFile.error() != QFile::NoError)
-	{
-		// TODO
-	}
+	QFile rulesFile(m_fullFilePath);
+	bool isFileEmpty = true;
 
-	m_isUpdated = true;
-	m_isEnabled = false;
+	if (rulesFile.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		parseHeader(&rulesFile, isFileEmpty);
 
-	clear();
-	parseRules();
+		m_isEmpty = isFileEmpty;
+	}
 }
 
 void ContentBlockingList::clear()
 {
-	QtConcurrent::run(this, &ContentBlockingList::deleteNode, m_root);
+	QMutexLocker locker(&m_matcherMutex);
+
+	++m_generation;
 
+	m_matcher.clear();
+	m_rulesHits.clear();
+	m_lookups = 0;
+	m_hits = 0;
 	m_cssHidingRules.clear();
 	m_cssHidingRulesExceptions.clear();
 	m_cssSpecificDomainHidingRules.clear();
 }
 
+void ContentBlockingList::setMatcher(ContentBlockingMatcher *matcher, int generation)
+{
+	QByteArray cosmeticData = matcher->getCosmeticData();
+	QDataStream stream(&cosmeticData, QIODevice::ReadOnly);
+	QStringList cssHidingRules;
+	QMultiHash<QString, QString> cssSpecificDomainHidingRules;
+	QMultiHash<QString, QString> cssHidingRulesExceptions;
+
+	stream >> cssHidingRules >> cssSpecificDomainHidingRules >> cssHidingRulesExceptions;
+
+	m_matcherMutex.lock();
+
+	if (generation != m_generation)
+	{
+		m_matcherMutex.unlock();
+
+		delete matcher;
+
+		return;
+	}
+
+	m_matcher = QSharedPointer<const ContentBlockingMatcher>(matcher);
+	m_rulesHits.clear();
+	m_lookups = 0;
+	m_hits = 0;
+	m_cssHidingRules = cssHidingRules;
+	m_cssSpecificDomainHidingRules = cssSpecificDomainHidingRules;
+	m_cssHidingRulesExceptions = cssHidingRulesExceptions;
+
+	m_matcherMutex.unlock();
+
+	emit updateCustomStyleSheets();
+}
+
 void ContentBlockingList::setListName(const QString &title)
 {
 	m_listName = title;
@@ -563,6 +664,31 @@ void ContentBlockingList::setConfigListName(const QString &name)
 	m_configListName = name;
 }
 
+void ContentBlockingList::setUpdateOption(const QString &key, const QVariant &value)
+{
+	if (m_configListName.isEmpty())
+	{
+		return;
+	}
+
+	QSettings adblock(SessionsManager::getProfilePath() + QLatin1String("/adblock.ini"), QSettings::IniFormat);
+	adblock.setIniCodec("UTF-8");
+	adblock.setValue(QStringLiteral("%1/%2").arg(m_configListName).arg(key), value);
+}
+
+QVariant ContentBlockingList::getUpdateOption(const QString &key) const
+{
+	if (m_configListName.isEmpty())
+	{
+		return QVariant();
+	}
+
+	QSettings adblock(SessionsManager::getProfilePath() + QLatin1String("/adblock.ini"), QSettings::IniFormat);
+	adblock.setIniCodec("UTF-8");
+
+	return adblock.value(QStringLiteral("%1/%2").arg(m_configListName).arg(key));
+}
+
 QString ContentBlockingList::getFileName() const
 {
 	return m_fileName;
@@ -573,8 +699,10 @@ QString ContentBlockingList::getListName() const
 	return m_listName;
 }
 
-QString ContentBlockingList::getCssRules() const
+QStringList ContentBlockingList::getCssRules() const
 {
+	QMutexLocker locker(&m_matcherMutex);
+
 	return m_cssHidingRules;
 }
 
@@ -590,102 +718,51 @@ QDateTime ContentBlockingList::getLastUpdate() const
 
 QMultiHash<QString, QString> ContentBlockingList::getSpecificDomainHidingRules() const
 {
+	QMutexLocker locker(&m_matcherMutex);
+
 	return m_cssSpecificDomainHidingRules;
 }
 
 QMultiHash<QString, QString> ContentBlockingList::getHidingRulesExceptions() const
 {
-	return m_cssHidingRulesExceptions;
-}
-
-bool ContentBlockingList::resolveDomainExceptions(const QString &url, const QStringList &ruleList)
-{
-	for (int i = 0; i < ruleList.count(); ++i)
-	{
-		if (url.contains(ruleList.at(i)))
-		{
-			return true;
-		}
-	}
+	QMutexLocker locker(&m_matcherMutex);
 
-	return false;
+	return m_cssHidingRulesExceptions;
 }
 
-bool ContentBlockingList::checkUrlSubstring(const QString &subString, const QNetworkRequest &request)
+ContentBlockingListStatistics ContentBlockingList::getStatistics(int rulesAmount) const
 {
-	Node *node = m_root;
-	m_currentRule.clear();
+	QMutexLocker locker(&m_matcherMutex);
+	ContentBlockingListStatistics statistics;
+	statistics.lookups = m_lookups;
+	statistics.hits = m_hits;
+	statistics.cosmeticRulesAmount = (m_cssHidingRules.count() + m_cssSpecificDomainHidingRules.count() + m_cssHidingRulesExceptions.count());
 
-	for (int i = 0; i < subString.length(); ++i)
+	if (!m_matcher)
 	{
-		const QChar treeChar = subString.at(i);
-
-		if (node->rule && checkRuleMatch(node->rule, request))
-		{
-			return true;
-		}
-
-		bool childrenExists = false;
-
-		for (int j = 0; j < node->children.count(); ++j)
-		{
-			Node *nextNode = node->children.at(j);
-
-			if (nextNode->value == treeChar)
-			{
-				node = nextNode;
-
-				childrenExists = true;
-
-				break;
-			}
-		}
+		return statistics;
+	}
 
-		if (!childrenExists)
-		{
-			return false;
-		}
+	statistics.memoryUsage = m_matcher->getSize();
+	statistics.rulesAmount = m_matcher->getRulesAmount();
+	statistics.skippedRulesAmount = m_matcher->getSkippedRulesAmount();
 
-		m_currentRule += treeChar;
-	}
+	QList<QPair<qint64, int> > rulesHits;
+	QHash<int, qint64>::const_iterator iterator;
 
-	if (node->rule && checkRuleMatch(node->rule, request))
+	for (iterator = m_rulesHits.constBegin(); iterator != m_rulesHits.constEnd(); ++iterator)
 	{
-		return true;
+		rulesHits.append(qMakePair(iterator.value(), iterator.key()));
 	}
 
-	return false;
-}
-
-bool ContentBlockingList::checkRuleMatch(ContentBlockingRule *rule, const QNetworkRequest &request)
-{
-	bool isBlocked = false;
+	qSort(rulesHits.begin(), rulesHits.end(), qGreater<QPair<qint64, int> >());
 
-	if (request.url().url().contains(m_currentRule))
+	for (int i = 0; i < qMin(rulesAmount, rulesHits.count()); ++i)
 	{
-		m_requestSubdomainList = ContentBlockingManager::createSubdomainList(request.url().host());
-
-		if (rule->needsDomainCheck)
-		{
-			if (!m_requestSubdomainList.contains(m_currentRule.left(m_currentRule.indexOf(m_domainExpression))))
-			{
-				return false;
-			}
-			else
-			{
-				isBlocked = true;
-			}
-		}
-
-		if (isBlocked)
-		{
-			isBlocked = !rule->isException;
-		}
-
-		resolveRuleOptions(rule, request, isBlocked);
+		statistics.rulesHits.append(qMakePair(m_matcher->getRuleText(rulesHits.at(i).second), rulesHits.at(i).first));
 	}
 
-	return isBlocked;
+	return statistics;
 }
 
 bool ContentBlockingList::isEnabled() const
@@ -693,24 +770,38 @@ bool ContentBlockingList::isEnabled() const
 	return m_isEnabled;
 }
 
-bool ContentBlockingList::isUrlBlocked(const QNetworkRequest &request, const QUrl &baseUrl)
+bool ContentBlockingList::isUrlBlocked(const QNetworkRequest &request, const QUrl &baseUrl) const
 {
-	const QString url = request.url().url();
-	const int urlLenght = url.length();
+	m_matcherMutex.lock();
+
+	const QSharedPointer<const ContentBlockingMatcher> matcher = m_matcher;
+
+	m_matcherMutex.unlock();
+
+	if (!matcher)
+	{
+		return false;
+	}
+
+	int rule = -1;
+	const bool isBlocked = matcher->isUrlBlocked(request, baseUrl, &rule);
 
-	m_baseUrl = baseUrl;
+	m_matcherMutex.lock();
 
-	for (int i = 0; i < urlLenght; ++i)
+	if (matcher == m_matcher)
 	{
-		const QString testString = url.right(urlLenght - i);
+		++m_lookups;
 
-		if (checkUrlSubstring(testString, request))
+		if (rule >= 0)
 		{
-			return true;
+			++m_hits;
+			++m_rulesHits[rule];
 		}
 	}
 
-	return false;
+	m_matcherMutex.unlock();
+
+	return isBlocked;
 }
 
 }
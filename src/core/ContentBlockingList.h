@@ -23,13 +23,32 @@
 
 #include "NetworkManager.h"
 
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QMutex>
 #include <QtCore/QObject>
 #include <QtCore/QRegularExpression>
+#include <QtCore/QSharedPointer>
 #include <QtCore/QUrl>
+#include <QtCore/QVector>
 
 namespace Otter
 {
 
+class ContentBlockingMatcher;
+
+struct ContentBlockingListStatistics
+{
+	QList<QPair<QString, qint64> > rulesHits;
+	qint64 lookups;
+	qint64 hits;
+	qint64 memoryUsage;
+	int rulesAmount;
+	int cosmeticRulesAmount;
+	int skippedRulesAmount;
+
+	ContentBlockingListStatistics() : lookups(0), hits(0), memoryUsage(0), rulesAmount(0), cosmeticRulesAmount(0), skippedRulesAmount(0) {}
+};
+
 class ContentBlockingList : public QObject
 {
 	Q_OBJECT
@@ -54,12 +73,19 @@ public:
 
 	struct ContentBlockingRule
 	{
+		QString pattern;
+		QString domain;
 		QStringList blockedDomains;
 		QStringList allowedDomains;
 		RuleOptions ruleOption;
 		RuleOptions exceptionRuleOption;
 		bool isException;
+		bool isLiteral;
+		bool isStartAnchored;
+		bool isEndAnchored;
 		bool needsDomainCheck;
+
+		ContentBlockingRule() : ruleOption(NoOption), exceptionRuleOption(NoOption), isException(false), isLiteral(true), isStartAnchored(false), isEndAnchored(false), needsDomainCheck(false) {}
 	};
 
 	void setEnabled(const bool enabled);
@@ -69,60 +95,69 @@ public:
 	QString getFileName() const;
 	QString getListName() const;
 	QString getConfigListName() const;
-	QString getCssRules() const;
+	QStringList getCssRules() const;
 	QDateTime getLastUpdate() const;
 	QMultiHash<QString, QString> getSpecificDomainHidingRules() const;
 	QMultiHash<QString, QString> getHidingRulesExceptions() const;
+	ContentBlockingListStatistics getStatistics(int rulesAmount = 20) const;
 	bool isEnabled() const;
-	bool isUrlBlocked(const QNetworkRequest &request, const QUrl &baseUrl);
+	bool isUrlBlocked(const QNetworkRequest &request, const QUrl &baseUrl) const;
 
 protected:
-	struct Node
+	enum UpdateResult
 	{
-		QChar value;
-		ContentBlockingRule *rule;
-		QVarLengthArray<Node*, 5> children;
-
-		Node() : value(0), rule(NULL) {}
+		SucceededResult = 0,
+		ChecksumMismatchResult = 1,
+		WriteFailedResult = 2
 	};
 
+	void timerEvent(QTimerEvent *event);
 	void parseRules();
-	void loadRuleFile();
+	void loadRuleFile(const QByteArray &checksum, int generation);
+	void scheduleUpdate(bool isUrgent);
 	void clear();
-	void parseRuleLine(QString line);
-	void resolveRuleOptions(ContentBlockingRule *rule, const QNetworkRequest &request, bool &isBlocked);
-	void parseCssRule(const QStringList &line, QMultiHash<QString, QString> &list);
-	void addRule(ContentBlockingRule *rule, const QString ruleString);
-	void deleteNode(Node *node);
-	void downloadUpdate();
-	bool resolveDomainExceptions(const QString &url, const QStringList &ruleList);
-	bool checkUrlSubstring(const QString &subString, const QNetworkRequest &request);
-	bool checkRuleMatch(ContentBlockingRule *rule, const QNetworkRequest &request);
+	bool parseRuleLine(QString line, QVector<ContentBlockingRule> &rules, QStringList &cssHidingRules, QMultiHash<QString, QString> &cssSpecificDomainHidingRules, QMultiHash<QString, QString> &cssHidingRulesExceptions) const;
+	void parseCssRule(const QStringList &line, QMultiHash<QString, QString> &list) const;
+	void setMatcher(ContentBlockingMatcher *matcher, int generation);
+	void setUpdateOption(const QString &key, const QVariant &value);
+	QVariant getUpdateOption(const QString &key) const;
+	int installUpdate(const QByteArray &header, const QByteArray &checksum, const QByteArray &data, const QUrl &url, int generation);
+	bool parseHeader(QIODevice *device, bool &isFileEmpty);
 
 private slots:
+	void downloadUpdate();
 	void updateDownloaded(QNetworkReply *reply);
+	void updateInstalled();
 
 private:
-	Node *m_root;
 	QNetworkReply *m_networkReply;
 	QDateTime m_lastUpdate;
 	QString m_fullFilePath;
 	QString m_fileName;
 	QString m_listName;
 	QString m_configListName;
-	QString m_cssHidingRules;
-	QString m_currentRule;
-	QUrl m_baseUrl;
 	QUrl m_updateUrl;
+	QStringList m_cssHidingRules;
 	QMultiHash<QString, QString> m_cssSpecificDomainHidingRules;
 	QMultiHash<QString, QString> m_cssHidingRulesExceptions;
 	QRegularExpression m_domainExpression;
-	QStringList m_requestSubdomainList;
+	QByteArray m_entityTag;
+	QByteArray m_lastModified;
+	QFutureWatcher<int> m_updateWatcher;
+	QSharedPointer<const ContentBlockingMatcher> m_matcher;
+	mutable QHash<int, qint64> m_rulesHits;
+	mutable QMutex m_matcherMutex;
+	mutable qint64 m_lookups;
+	mutable qint64 m_hits;
+	int m_generation;
 	int m_daysToExpire;
+	int m_checkTimer;
+	bool m_isEmpty;
 	bool m_isUpdated;
 	bool m_isEnabled;
 
 	static NetworkManager *m_networkManager;
+	static int m_scheduledUpdates;
 
 signals:
 	void updateCustomStyleSheets();
@@ -23,7 +23,10 @@
 #include "SettingsManager.h"
 #include "SessionsManager.h"
 
+#include <QtCore/QCoreApplication>
 #include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QSet>
 #include <QtCore/QSettings>
 
 namespace Otter
@@ -31,9 +34,18 @@ namespace Otter
 
 ContentBlockingManager* ContentBlockingManager::m_instance = NULL;
 QList<ContentBlockingList*> ContentBlockingManager::m_blockingLists;
-QByteArray ContentBlockingManager::m_hidingRules;
+QByteArray ContentBlockingManager::m_encodedStyleSheet;
 QMultiHash<QString, QString> ContentBlockingManager::m_specificDomainHidingRules;
 QMultiHash<QString, QString> ContentBlockingManager::m_hidingRulesExceptions;
+QStringList ContentBlockingManager::m_genericHidingRules;
+QSet<QString> ContentBlockingManager::m_genericHidingRulesSet;
+QHash<QString, QByteArray> ContentBlockingManager::m_genericStyleSheets;
+QHash<QString, QByteArray> ContentBlockingManager::m_domainStyleSheets;
+QCache<QString, bool> ContentBlockingManager::m_decisionsCache(1000);
+ContentBlockingStatistics ContentBlockingManager::m_statistics;
+QVector<qint64> ContentBlockingManager::m_evaluationTimes(64, 0);
+QMutex ContentBlockingManager::m_decisionsMutex;
+int ContentBlockingManager::m_styleSheetsGeneration = 0;
 bool ContentBlockingManager::m_isContentBlockingEnabled = false;
 
 ContentBlockingManager::ContentBlockingManager(QObject *parent) : QObject(parent)
@@ -147,6 +159,8 @@ void ContentBlockingManager::updateLists()
 
 	m_isContentBlockingEnabled = false;
 
+	clearDecisionsCache();
+
 	for (int i = 0; i < entries.count(); ++i)
 	{
 		for (int j = 0; j < m_blockingLists.count(); ++j)
@@ -178,17 +192,35 @@ void ContentBlockingManager::updateLists()
 
 void ContentBlockingManager::updateCustomStyleSheets()
 {
-	m_hidingRules.clear();
 	m_specificDomainHidingRules.clear();
 	m_hidingRulesExceptions.clear();
+	m_genericHidingRules.clear();
+	m_genericHidingRulesSet.clear();
+	m_genericStyleSheets.clear();
+	m_domainStyleSheets.clear();
+
+	clearDecisionsCache();
 
 	for (int i = 0; i < m_blockingLists.count(); ++i)
 	{
-		m_hidingRules.append(m_blockingLists.at(i)->getCssRules());
+		const QStringList rules = m_blockingLists.at(i)->getCssRules();
+
+		for (int j = 0; j < rules.count(); ++j)
+		{
+			if (!m_genericHidingRulesSet.contains(rules.at(j)))
+			{
+				m_genericHidingRulesSet.insert(rules.at(j));
+				m_genericHidingRules.append(rules.at(j));
+			}
+		}
+
 		m_specificDomainHidingRules += m_blockingLists.at(i)->getSpecificDomainHidingRules();
 		m_hidingRulesExceptions += m_blockingLists.at(i)->getHidingRulesExceptions();
 	}
 
+	m_encodedStyleSheet = createGenericStyleSheet(QSet<QString>());
+	++m_styleSheetsGeneration;
+
 	emit styleSheetsUpdated();
 }
 
@@ -197,9 +229,161 @@ ContentBlockingManager* ContentBlockingManager::getInstance()
 	return m_instance;
 }
 
-QByteArray ContentBlockingManager::getStyleSheetHidingRules()
+QByteArray ContentBlockingManager::encodeStyleSheet(QByteArray styleSheet)
+{
+	while (styleSheet.size() % 3 != 0)
+	{
+		styleSheet.append(' ');
+	}
+
+	return styleSheet.toBase64();
+}
+
+QByteArray ContentBlockingManager::getEncodedStyleSheet(const QString &host)
+{
+	if (host.isEmpty() || m_hidingRulesExceptions.isEmpty())
+	{
+		return m_encodedStyleSheet;
+	}
+
+	const QHash<QString, QByteArray>::const_iterator cachedStyleSheet = m_genericStyleSheets.constFind(host);
+
+	if (cachedStyleSheet != m_genericStyleSheets.constEnd())
+	{
+		return cachedStyleSheet.value();
+	}
+
+	const QSet<QString> exceptions = createHidingRulesExceptions(host);
+	bool isFiltered = false;
+	QSet<QString>::const_iterator iterator;
+
+	for (iterator = exceptions.constBegin(); iterator != exceptions.constEnd(); ++iterator)
+	{
+		if (m_genericHidingRulesSet.contains(*iterator))
+		{
+			isFiltered = true;
+
+			break;
+		}
+	}
+
+	if (m_genericStyleSheets.count() > 100)
+	{
+		m_genericStyleSheets.clear();
+	}
+
+	const QByteArray encodedStyleSheet = (isFiltered ? createGenericStyleSheet(exceptions) : m_encodedStyleSheet);
+
+	m_genericStyleSheets[host] = encodedStyleSheet;
+
+	return encodedStyleSheet;
+}
+
+QByteArray ContentBlockingManager::getEncodedDomainStyleSheet(const QString &host)
+{
+	if (host.isEmpty() || (m_specificDomainHidingRules.isEmpty() && m_hidingRulesExceptions.isEmpty()))
+	{
+		return QByteArray();
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	const QByteArray styleSheet = createDomainStyleSheet(host);
+	const qint64 filteringTime = timer.nsecsElapsed();
+
+	QMutexLocker locker(&m_decisionsMutex);
+
+	++m_statistics.cosmeticFilteringPages;
+
+	m_statistics.cosmeticFilteringTime += filteringTime;
+	m_statistics.maximumCosmeticFilteringTime = qMax(m_statistics.maximumCosmeticFilteringTime, filteringTime);
+
+	return styleSheet;
+}
+
+QByteArray ContentBlockingManager::createDomainStyleSheet(const QString &host)
+{
+	const QHash<QString, QByteArray>::const_iterator cachedStyleSheet = m_domainStyleSheets.constFind(host);
+
+	if (cachedStyleSheet != m_domainStyleSheets.constEnd())
+	{
+		return cachedStyleSheet.value();
+	}
+
+	const QStringList domains = createSubdomainList(host);
+	const QSet<QString> exceptions = createHidingRulesExceptions(host);
+	QSet<QString> selectors;
+	QByteArray styleSheet;
+
+	for (int i = 0; i < domains.count(); ++i)
+	{
+		const QList<QString> rules = m_specificDomainHidingRules.values(domains.at(i));
+
+		for (int j = 0; j < rules.count(); ++j)
+		{
+			if (!exceptions.contains(rules.at(j)) && !selectors.contains(rules.at(j)))
+			{
+				selectors.insert(rules.at(j));
+
+				styleSheet.append(rules.at(j).toUtf8() + QByteArray("{display:none !important;}\n"));
+			}
+		}
+	}
+
+	if (m_domainStyleSheets.count() > 100)
+	{
+		m_domainStyleSheets.clear();
+	}
+
+	const QByteArray encodedStyleSheet = encodeStyleSheet(styleSheet);
+
+	m_domainStyleSheets[host] = encodedStyleSheet;
+
+	return encodedStyleSheet;
+}
+
+QByteArray ContentBlockingManager::createGenericStyleSheet(const QSet<QString> &exceptions)
+{
+	QStringList chunk;
+	QByteArray styleSheet;
+
+	for (int i = 0; i < m_genericHidingRules.count(); ++i)
+	{
+		if (exceptions.contains(m_genericHidingRules.at(i)))
+		{
+			continue;
+		}
+
+		chunk.append(m_genericHidingRules.at(i));
+
+		if (chunk.count() == 1000)
+		{
+			styleSheet.append(chunk.join(QLatin1Char(',')).toUtf8() + QByteArray("{display:none;}\n"));
+
+			chunk.clear();
+		}
+	}
+
+	if (!chunk.isEmpty())
+	{
+		styleSheet.append(chunk.join(QLatin1Char(',')).toUtf8() + QByteArray("{display:none;}\n"));
+	}
+
+	return encodeStyleSheet(styleSheet);
+}
+
+QSet<QString> ContentBlockingManager::createHidingRulesExceptions(const QString &host)
 {
-	return m_hidingRules;
+	const QStringList domains = createSubdomainList(host);
+	QSet<QString> exceptions;
+
+	for (int i = 0; i < domains.count(); ++i)
+	{
+		exceptions += m_hidingRulesExceptions.values(domains.at(i)).toSet();
+	}
+
+	return exceptions;
 }
 
 QStringList ContentBlockingManager::createSubdomainList(const QString &domain)
@@ -235,6 +419,74 @@ QMultiHash<QString, QString> ContentBlockingManager::getHidingRulesExceptions()
 	return m_hidingRulesExceptions;
 }
 
+void ContentBlockingManager::clearDecisionsCache()
+{
+	QMutexLocker locker(&m_decisionsMutex);
+
+	m_decisionsCache.clear();
+}
+
+void ContentBlockingManager::logStatistics()
+{
+	const ContentBlockingStatistics statistics = getStatistics();
+	const qint64 lookups = (statistics.cacheHits + statistics.cacheMisses);
+	QStringList lines;
+	lines.append(QStringLiteral("Content blocking: %1 lookups, %2 blocked, %3 cached; evaluation %4 ms total, median %5 us, 99th percentile %6 us, maximum %7 us; cosmetic filtering %8 ms on %9 pages, maximum %10 us").arg(lookups).arg(statistics.blockedRequests).arg(statistics.cacheHits).arg(statistics.evaluationTime / 1000000).arg(statistics.medianEvaluationTime / 1000).arg(statistics.highEvaluationTime / 1000).arg(statistics.maximumEvaluationTime / 1000).arg(statistics.cosmeticFilteringTime / 1000000).arg(statistics.cosmeticFilteringPages).arg(statistics.maximumCosmeticFilteringTime / 1000));
+
+	for (int i = 0; i < m_blockingLists.count(); ++i)
+	{
+		if (!m_blockingLists.at(i)->isEnabled())
+		{
+			continue;
+		}
+
+		const ContentBlockingListStatistics listStatistics = m_blockingLists.at(i)->getStatistics(5);
+		QStringList rules;
+
+		for (int j = 0; j < listStatistics.rulesHits.count(); ++j)
+		{
+			rules.append(QStringLiteral("%1 (%2)").arg(listStatistics.rulesHits.at(j).first).arg(listStatistics.rulesHits.at(j).second));
+		}
+
+		lines.append(QStringLiteral("%1: %2 rules, %3 cosmetic rules, %4 skipped, %5 KiB; %6 lookups, %7 hits; top rules: %8").arg(m_blockingLists.at(i)->getFileName()).arg(listStatistics.rulesAmount).arg(listStatistics.cosmeticRulesAmount).arg(listStatistics.skippedRulesAmount).arg(listStatistics.memoryUsage / 1024).arg(listStatistics.lookups).arg(listStatistics.hits).arg(rules.join(QLatin1String(", "))));
+	}
+
+	Console::addMessage(lines.join(QLatin1Char('\n')), Otter::NetworkMessageCategory, LogMessageLevel);
+}
+
+ContentBlockingStatistics ContentBlockingManager::getStatistics()
+{
+	QMutexLocker locker(&m_decisionsMutex);
+	ContentBlockingStatistics statistics = m_statistics;
+	statistics.medianEvaluationTime = getEvaluationTimePercentile(50);
+	statistics.highEvaluationTime = getEvaluationTimePercentile(99);
+
+	return statistics;
+}
+
+qint64 ContentBlockingManager::getEvaluationTimePercentile(int percentile)
+{
+	const qint64 threshold = (((m_statistics.cacheMisses * percentile) + 99) / 100);
+	qint64 amount = 0;
+
+	if (threshold == 0)
+	{
+		return 0;
+	}
+
+	for (int i = 0; i < m_evaluationTimes.count(); ++i)
+	{
+		amount += m_evaluationTimes.at(i);
+
+		if (amount >= threshold)
+		{
+			return qMin((Q_INT64_C(1) << (i + 1)), m_statistics.maximumEvaluationTime);
+		}
+	}
+
+	return m_statistics.maximumEvaluationTime;
+}
+
 bool ContentBlockingManager::isUrlBlocked(const QNetworkRequest &request, const QUrl &baseUrl)
 {
 	const QString scheme = request.url().scheme();
@@ -244,6 +496,72 @@ bool ContentBlockingManager::isUrlBlocked(const QNetworkRequest &request, const
 		return false;
 	}
 
+	const QString key = (request.url().url() + QLatin1Char('\n') + baseUrl.host() + QLatin1Char('\n') + QString::fromLatin1(request.rawHeader(QByteArray("Accept"))) + QLatin1Char('\n') + QString::fromLatin1(request.rawHeader(QByteArray("X-Requested-With"))));
+
+	m_decisionsMutex.lock();
+
+	const bool *cachedDecision = m_decisionsCache.object(key);
+
+	if (cachedDecision)
+	{
+		const bool isBlocked = *cachedDecision;
+
+		++m_statistics.cacheHits;
+
+		if (isBlocked)
+		{
+			++m_statistics.blockedRequests;
+		}
+
+		m_statistics.savedTime += (m_statistics.evaluationTime / qMax(Q_INT64_C(1), m_statistics.cacheMisses));
+
+		m_decisionsMutex.unlock();
+
+		return isBlocked;
+	}
+
+	m_decisionsMutex.unlock();
+
+	QElapsedTimer timer;
+	timer.start();
+
+	const bool isBlocked = evaluateUrl(request, baseUrl);
+	const qint64 evaluationTime = timer.nsecsElapsed();
+
+	if (evaluationTime > 20000000 && Console::hasListeners())
+	{
+		Console::addMessage(QCoreApplication::translate("main", "Content blocking lookup took %1 ms: %2").arg(evaluationTime / 1000000).arg(request.url().toString()), Otter::NetworkMessageCategory, WarningMessageLevel);
+	}
+
+	int bucket = 0;
+
+	while (bucket < 62 && (evaluationTime >> (bucket + 1)) > 0)
+	{
+		++bucket;
+	}
+
+	m_decisionsMutex.lock();
+
+	++m_statistics.cacheMisses;
+	++m_evaluationTimes[bucket];
+
+	if (isBlocked)
+	{
+		++m_statistics.blockedRequests;
+	}
+
+	m_statistics.evaluationTime += evaluationTime;
+	m_statistics.maximumEvaluationTime = qMax(m_statistics.maximumEvaluationTime, evaluationTime);
+
+	m_decisionsCache.insert(key, new bool(isBlocked));
+
+	m_decisionsMutex.unlock();
+
+	return isBlocked;
+}
+
+bool ContentBlockingManager::evaluateUrl(const QNetworkRequest &request, const QUrl &baseUrl)
+{
 	for (int i = 0; i < m_blockingLists.count(); ++i)
 	{
 		if (m_blockingLists.at(i)->isEnabled())
@@ -258,6 +576,11 @@ bool ContentBlockingManager::isUrlBlocked(const QNetworkRequest &request, const
 	return false;
 }
 
+int ContentBlockingManager::getStyleSheetsGeneration()
+{
+	return m_styleSheetsGeneration;
+}
+
 bool ContentBlockingManager::isContentBlockingEnabled()
 {
 	return m_isContentBlockingEnabled;
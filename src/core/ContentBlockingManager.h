@@ -20,7 +20,11 @@
 #ifndef OTTER_CONTENTBLOCKINGMANAGER_H
 #define OTTER_CONTENTBLOCKINGMANAGER_H
 
+#include <QtCore/QCache>
+#include <QtCore/QMutex>
 #include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QVector>
 #include <QtNetwork/QNetworkRequest>
 
 namespace Otter
@@ -28,6 +32,23 @@ namespace Otter
 
 class ContentBlockingList;
 
+struct ContentBlockingStatistics
+{
+	qint64 cacheHits;
+	qint64 cacheMisses;
+	qint64 blockedRequests;
+	qint64 evaluationTime;
+	qint64 medianEvaluationTime;
+	qint64 highEvaluationTime;
+	qint64 maximumEvaluationTime;
+	qint64 savedTime;
+	qint64 cosmeticFilteringTime;
+	qint64 maximumCosmeticFilteringTime;
+	qint64 cosmeticFilteringPages;
+
+	ContentBlockingStatistics() : cacheHits(0), cacheMisses(0), blockedRequests(0), evaluationTime(0), medianEvaluationTime(0), highEvaluationTime(0), maximumEvaluationTime(0), savedTime(0), cosmeticFilteringTime(0), maximumCosmeticFilteringTime(0), cosmeticFilteringPages(0) {}
+};
+
 class ContentBlockingManager : public QObject
 {
 	Q_OBJECT
@@ -35,12 +56,17 @@ class ContentBlockingManager : public QObject
 public:
 	static void createInstance(QObject *parent = NULL);
 	static void updateLists();
+	static void logStatistics();
 	static ContentBlockingManager* getInstance();
-	static QByteArray getStyleSheetHidingRules();
+	static QByteArray encodeStyleSheet(QByteArray styleSheet);
+	static QByteArray getEncodedStyleSheet(const QString &host = QString());
+	static QByteArray getEncodedDomainStyleSheet(const QString &host);
 	static QStringList createSubdomainList(const QString &domain);
 	static QList<ContentBlockingList*> getBlockingDefinitions();
 	static QMultiHash<QString, QString> getSpecificDomainHidingRules();
 	static QMultiHash<QString, QString> getHidingRulesExceptions();
+	static ContentBlockingStatistics getStatistics();
+	static int getStyleSheetsGeneration();
 	static bool isUrlBlocked(const QNetworkRequest &request, const QUrl &baseUrl);
 	static bool isContentBlockingEnabled();
 
@@ -48,6 +74,12 @@ protected:
 	explicit ContentBlockingManager(QObject *parent = NULL);
 
 	static void loadLists();
+	static void clearDecisionsCache();
+	static QByteArray createGenericStyleSheet(const QSet<QString> &exceptions);
+	static QByteArray createDomainStyleSheet(const QString &host);
+	static QSet<QString> createHidingRulesExceptions(const QString &host);
+	static qint64 getEvaluationTimePercentile(int percentile);
+	static bool evaluateUrl(const QNetworkRequest &request, const QUrl &baseUrl);
 
 protected slots:
 	void updateCustomStyleSheets();
@@ -55,9 +87,18 @@ protected slots:
 private:
 	static ContentBlockingManager *m_instance;
 	static QList<ContentBlockingList*> m_blockingLists;
-	static QByteArray m_hidingRules;
+	static QByteArray m_encodedStyleSheet;
 	static QMultiHash<QString, QString> m_specificDomainHidingRules;
 	static QMultiHash<QString, QString> m_hidingRulesExceptions;
+	static QStringList m_genericHidingRules;
+	static QSet<QString> m_genericHidingRulesSet;
+	static QHash<QString, QByteArray> m_genericStyleSheets;
+	static QHash<QString, QByteArray> m_domainStyleSheets;
+	static QCache<QString, bool> m_decisionsCache;
+	static ContentBlockingStatistics m_statistics;
+	static QVector<qint64> m_evaluationTimes;
+	static QMutex m_decisionsMutex;
+	static int m_styleSheetsGeneration;
 	static bool m_isContentBlockingEnabled;
 
 signals:
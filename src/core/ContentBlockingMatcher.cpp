@@ -0,0 +1,1128 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2014 Jan Bajer aka bajasoft <jbajer@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#include "ContentBlockingMatcher.h"
+#include "PublicSuffixManager.h"
+
+#include <QtCore/QMap>
+#include <QtCore/QSaveFile>
+#include <QtCore/QtAlgorithms>
+#include <QtNetwork/QNetworkRequest>
+
+#include <cstring>
+
+namespace Otter
+{
+
+ContentBlockingMatcher::ContentBlockingMatcher() :
+	m_file(NULL),
+	m_data(NULL),
+	m_header(NULL),
+	m_states(NULL),
+	m_transitionValues(NULL),
+	m_transitionStates(NULL),
+	m_rules(NULL),
+	m_buckets(NULL),
+	m_bucketRules(NULL),
+	m_untokenizedRules(NULL),
+	m_domains(NULL),
+	m_strings(NULL),
+	m_size(0)
+{
+}
+
+ContentBlockingMatcher::ContentBlockingMatcher(const QByteArray &data) :
+	m_file(NULL),
+	m_buffer(data),
+	m_data(NULL),
+	m_header(NULL),
+	m_states(NULL),
+	m_transitionValues(NULL),
+	m_transitionStates(NULL),
+	m_rules(NULL),
+	m_buckets(NULL),
+	m_bucketRules(NULL),
+	m_untokenizedRules(NULL),
+	m_domains(NULL),
+	m_strings(NULL),
+	m_size(0)
+{
+	setData(reinterpret_cast<const uchar*>(m_buffer.constData()), m_buffer.size());
+}
+
+ContentBlockingMatcher::~ContentBlockingMatcher()
+{
+	delete m_file;
+}
+
+void ContentBlockingMatcher::setData(const uchar *data, qint64 size)
+{
+	m_data = data;
+	m_size = size;
+	m_header = NULL;
+
+	if (!data || size < qint64(sizeof(Header)))
+	{
+		return;
+	}
+
+	const Header *header = reinterpret_cast<const Header*>(data);
+
+	if (header->magic != CacheMagic || header->version != CacheVersion || header->statesAmount == 0)
+	{
+		return;
+	}
+
+	if (!isSectionValid(header->statesOffset, header->statesAmount, sizeof(State), size) || !isSectionValid(header->transitionValuesOffset, header->transitionsAmount, 1, size) || !isSectionValid(header->transitionStatesOffset, header->transitionsAmount, sizeof(qint32), size) || !isSectionValid(header->rulesOffset, header->rulesAmount, sizeof(Rule), size) || !isSectionValid(header->bucketsOffset, header->bucketsAmount, sizeof(Bucket), size) || !isSectionValid(header->bucketRulesOffset, header->bucketRulesAmount, sizeof(quint32), size) || !isSectionValid(header->untokenizedRulesOffset, header->untokenizedRulesAmount, sizeof(quint32), size) || !isSectionValid(header->domainsOffset, header->domainsAmount, sizeof(StringReference), size) || !isSectionValid(header->stringsOffset, header->stringsLength, 1, size) || !isSectionValid(header->cosmeticDataOffset, header->cosmeticDataLength, 1, size))
+	{
+		return;
+	}
+
+	m_states = reinterpret_cast<const State*>(data + header->statesOffset);
+	m_transitionValues = (data + header->transitionValuesOffset);
+	m_transitionStates = reinterpret_cast<const qint32*>(data + header->transitionStatesOffset);
+	m_rules = reinterpret_cast<const Rule*>(data + header->rulesOffset);
+	m_buckets = reinterpret_cast<const Bucket*>(data + header->bucketsOffset);
+	m_bucketRules = reinterpret_cast<const quint32*>(data + header->bucketRulesOffset);
+	m_untokenizedRules = reinterpret_cast<const quint32*>(data + header->untokenizedRulesOffset);
+	m_domains = reinterpret_cast<const StringReference*>(data + header->domainsOffset);
+	m_strings = reinterpret_cast<const char*>(data + header->stringsOffset);
+	m_header = header;
+
+	if (!isDataValid())
+	{
+		m_header = NULL;
+	}
+}
+
+ContentBlockingMatcher* ContentBlockingMatcher::load(const QString &path, const QByteArray &checksum)
+{
+	QFile *file = new QFile(path);
+
+	if (!file->open(QIODevice::ReadOnly) || file->size() < qint64(sizeof(Header)))
+	{
+		delete file;
+
+		return NULL;
+	}
+
+	const uchar *data = file->map(0, file->size());
+
+	if (!data)
+	{
+		delete file;
+
+		return NULL;
+	}
+
+	ContentBlockingMatcher *matcher = new ContentBlockingMatcher();
+	matcher->m_file = file;
+	matcher->setData(data, file->size());
+
+	if (!matcher->isValid() || checksum.size() != 16 || memcmp(matcher->m_header->checksum, checksum.constData(), 16) != 0)
+	{
+		delete matcher;
+
+		return NULL;
+	}
+
+	return matcher;
+}
+
+QByteArray ContentBlockingMatcher::compile(QVector<ContentBlockingList::ContentBlockingRule> rules, const QByteArray &checksum, const QByteArray &cosmeticData, int skippedRulesAmount)
+{
+	const State emptyState = {0, -1, -1, 0, 0};
+	QVector<State> states;
+	states.append(emptyState);
+
+	QVector<QMap<uchar, int> > children;
+	children.append(QMap<uchar, int>());
+
+	QVector<QByteArray> patterns;
+	patterns.reserve(rules.count());
+
+	for (int i = 0; i < rules.count(); ++i)
+	{
+		patterns.append(rules.at(i).pattern.toUtf8());
+	}
+
+	QVector<qint32> nextRules(rules.count(), -1);
+
+	for (int i = 0; i < rules.count(); ++i)
+	{
+		if (!rules.at(i).isLiteral)
+		{
+			continue;
+		}
+
+		const QByteArray &pattern = patterns.at(i);
+		int state = 0;
+
+		for (int j = 0; j < pattern.length(); ++j)
+		{
+			const uchar value = pattern.at(j);
+			const QMap<uchar, int>::const_iterator child = children.at(state).constFind(value);
+
+			if (child == children.at(state).constEnd())
+			{
+				const int newState = states.count();
+
+				children[state][value] = newState;
+				children.append(QMap<uchar, int>());
+
+				states.append(emptyState);
+
+				state = newState;
+			}
+			else
+			{
+				state = child.value();
+			}
+		}
+
+		nextRules[i] = states.at(state).rule;
+
+		states[state].rule = i;
+	}
+
+	QVector<int> queue;
+	queue.reserve(states.count());
+	queue.append(0);
+
+	for (int i = 0; i < queue.count(); ++i)
+	{
+		const int state = queue.at(i);
+		QMap<uchar, int>::const_iterator iterator;
+
+		for (iterator = children.at(state).constBegin(); iterator != children.at(state).constEnd(); ++iterator)
+		{
+			const int child = iterator.value();
+			int failure = states.at(state).failure;
+
+			while (failure != 0 && !children.at(failure).contains(iterator.key()))
+			{
+				failure = states.at(failure).failure;
+			}
+
+			failure = children.at(failure).value(iterator.key(), 0);
+
+			if (failure == child)
+			{
+				failure = 0;
+			}
+
+			states[child].failure = failure;
+			states[child].output = ((failure != 0 && states.at(failure).rule >= 0) ? failure : states.at(failure).output);
+
+			queue.append(child);
+		}
+	}
+
+	QVector<uchar> transitionValues;
+	QVector<qint32> transitionStates;
+	transitionValues.reserve(states.count() - 1);
+	transitionStates.reserve(states.count() - 1);
+
+	for (int i = 0; i < states.count(); ++i)
+	{
+		states[i].firstTransition = transitionValues.count();
+		states[i].transitionsAmount = children.at(i).count();
+
+		QMap<uchar, int>::const_iterator iterator;
+
+		for (iterator = children.at(i).constBegin(); iterator != children.at(i).constEnd(); ++iterator)
+		{
+			transitionValues.append(iterator.key());
+			transitionStates.append(iterator.value());
+		}
+	}
+
+	children.clear();
+
+	QVector<QVector<QPair<uint, int> > > candidates(rules.count());
+	QHash<uint, int> frequencies;
+
+	for (int i = 0; i < rules.count(); ++i)
+	{
+		if (rules.at(i).isLiteral)
+		{
+			continue;
+		}
+
+		const QByteArray &pattern = patterns.at(i);
+		int start = -1;
+
+		for (int j = 0; j <= pattern.length(); ++j)
+		{
+			if (j < pattern.length() && isTokenCharacter(pattern.at(j)))
+			{
+				if (start < 0)
+				{
+					start = j;
+				}
+
+				continue;
+			}
+
+			if (start < 0)
+			{
+				continue;
+			}
+
+			const bool isStartBounded = ((start == 0) ? (rules.at(i).needsDomainCheck || rules.at(i).isStartAnchored) : (pattern.at(start - 1) != '*'));
+			const bool isEndBounded = ((j == pattern.length()) ? rules.at(i).isEndAnchored : (pattern.at(j) != '*'));
+
+			if (isStartBounded && isEndBounded)
+			{
+				uint hash = 2166136261U;
+
+				for (int k = start; k < j; ++k)
+				{
+					hash = ((hash ^ uchar(pattern.at(k))) * 16777619U);
+				}
+
+				candidates[i].append(qMakePair(hash, (j - start)));
+
+				++frequencies[hash];
+			}
+
+			start = -1;
+		}
+	}
+
+	QHash<uint, QVector<quint32> > tokenBuckets;
+	QVector<quint32> untokenizedRules;
+
+	for (int i = 0; i < rules.count(); ++i)
+	{
+		if (rules.at(i).isLiteral)
+		{
+			continue;
+		}
+
+		if (candidates.at(i).isEmpty())
+		{
+			untokenizedRules.append(i);
+
+			continue;
+		}
+
+		QPair<uint, int> token = candidates.at(i).first();
+
+		for (int j = 1; j < candidates.at(i).count(); ++j)
+		{
+			const int frequency = frequencies.value(candidates.at(i).at(j).first);
+			const int currentFrequency = frequencies.value(token.first);
+
+			if (frequency < currentFrequency || (frequency == currentFrequency && candidates.at(i).at(j).second > token.second))
+			{
+				token = candidates.at(i).at(j);
+			}
+		}
+
+		tokenBuckets[token.first].append(i);
+	}
+
+	QList<uint> hashes = tokenBuckets.keys();
+
+	qSort(hashes);
+
+	QVector<Bucket> buckets;
+	QVector<quint32> bucketRules;
+
+	buckets.reserve(hashes.count());
+
+	for (int i = 0; i < hashes.count(); ++i)
+	{
+		const QVector<quint32> bucketContent = tokenBuckets.value(hashes.at(i));
+		Bucket bucket;
+		bucket.hash = hashes.at(i);
+		bucket.firstRule = bucketRules.count();
+		bucket.rulesAmount = bucketContent.count();
+
+		bucketRules += bucketContent;
+		buckets.append(bucket);
+	}
+
+	QByteArray strings;
+	QVector<StringReference> domains;
+	QVector<Rule> compiledRules;
+	compiledRules.reserve(rules.count());
+
+	for (int i = 0; i < rules.count(); ++i)
+	{
+		const ContentBlockingList::ContentBlockingRule &rule = rules.at(i);
+		Rule compiledRule;
+		compiledRule.pattern = appendString(strings, patterns.at(i));
+		compiledRule.domain = appendString(strings, rule.domain.toUtf8());
+		compiledRule.firstBlockedDomain = domains.count();
+		compiledRule.blockedDomainsAmount = rule.blockedDomains.count();
+
+		for (int j = 0; j < rule.blockedDomains.count(); ++j)
+		{
+			domains.append(appendString(strings, rule.blockedDomains.at(j).toUtf8()));
+		}
+
+		compiledRule.firstAllowedDomain = domains.count();
+		compiledRule.allowedDomainsAmount = rule.allowedDomains.count();
+
+		for (int j = 0; j < rule.allowedDomains.count(); ++j)
+		{
+			domains.append(appendString(strings, rule.allowedDomains.at(j).toUtf8()));
+		}
+
+		compiledRule.nextRule = nextRules.at(i);
+		compiledRule.ruleOption = int(rule.ruleOption);
+		compiledRule.exceptionRuleOption = int(rule.exceptionRuleOption);
+		compiledRule.flags = NoFlag;
+
+		if (rule.isException)
+		{
+			compiledRule.flags |= ExceptionFlag;
+		}
+
+		if (rule.isLiteral)
+		{
+			compiledRule.flags |= LiteralFlag;
+		}
+
+		if (rule.isStartAnchored)
+		{
+			compiledRule.flags |= StartAnchoredFlag;
+		}
+
+		if (rule.isEndAnchored)
+		{
+			compiledRule.flags |= EndAnchoredFlag;
+		}
+
+		if (rule.needsDomainCheck)
+		{
+			compiledRule.flags |= DomainCheckFlag;
+		}
+
+		compiledRules.append(compiledRule);
+	}
+
+	rules.clear();
+	patterns.clear();
+
+	Header header;
+
+	memset(&header, 0, sizeof(Header));
+
+	header.magic = CacheMagic;
+	header.version = CacheVersion;
+	header.skippedRulesAmount = skippedRulesAmount;
+
+	memcpy(header.checksum, checksum.constData(), qMin(16, checksum.size()));
+
+	QByteArray data(sizeof(Header), '\0');
+	header.statesAmount = states.count();
+	header.statesOffset = appendSection(data, states.constData(), (states.count() * sizeof(State)));
+	header.transitionsAmount = transitionValues.count();
+	header.transitionValuesOffset = appendSection(data, transitionValues.constData(), transitionValues.count());
+	header.transitionStatesOffset = appendSection(data, transitionStates.constData(), (transitionStates.count() * sizeof(qint32)));
+	header.rulesAmount = compiledRules.count();
+	header.rulesOffset = appendSection(data, compiledRules.constData(), (compiledRules.count() * sizeof(Rule)));
+	header.bucketsAmount = buckets.count();
+	header.bucketsOffset = appendSection(data, buckets.constData(), (buckets.count() * sizeof(Bucket)));
+	header.bucketRulesAmount = bucketRules.count();
+	header.bucketRulesOffset = appendSection(data, bucketRules.constData(), (bucketRules.count() * sizeof(quint32)));
+	header.untokenizedRulesAmount = untokenizedRules.count();
+	header.untokenizedRulesOffset = appendSection(data, untokenizedRules.constData(), (untokenizedRules.count() * sizeof(quint32)));
+	header.domainsAmount = domains.count();
+	header.domainsOffset = appendSection(data, domains.constData(), (domains.count() * sizeof(StringReference)));
+	header.stringsLength = strings.size();
+	header.stringsOffset = appendSection(data, strings.constData(), strings.size());
+	header.cosmeticDataLength = cosmeticData.size();
+	header.cosmeticDataOffset = appendSection(data, cosmeticData.constData(), cosmeticData.size());
+
+	memcpy(data.data(), &header, sizeof(Header));
+
+	return data;
+}
+
+const ContentBlockingMatcher::Bucket* ContentBlockingMatcher::findBucket(uint hash) const
+{
+	int first = 0;
+	int last = (int(m_header->bucketsAmount) - 1);
+
+	while (first <= last)
+	{
+		const int middle = ((first + last) / 2);
+
+		if (m_buckets[middle].hash == hash)
+		{
+			return &m_buckets[middle];
+		}
+
+		if (m_buckets[middle].hash < hash)
+		{
+			first = (middle + 1);
+		}
+		else
+		{
+			last = (middle - 1);
+		}
+	}
+
+	return NULL;
+}
+
+ContentBlockingMatcher::StringReference ContentBlockingMatcher::appendString(QByteArray &strings, const QByteArray &string)
+{
+	StringReference reference;
+	reference.offset = strings.size();
+	reference.length = string.size();
+
+	strings.append(string);
+
+	return reference;
+}
+
+QByteArray ContentBlockingMatcher::getString(const StringReference &reference) const
+{
+	return QByteArray::fromRawData((m_strings + reference.offset), reference.length);
+}
+
+QByteArray ContentBlockingMatcher::getCosmeticData() const
+{
+	if (!m_header)
+	{
+		return QByteArray();
+	}
+
+	return QByteArray(reinterpret_cast<const char*>(m_data + m_header->cosmeticDataOffset), m_header->cosmeticDataLength);
+}
+
+QString ContentBlockingMatcher::getRuleText(int index) const
+{
+	if (!m_header || index < 0 || quint32(index) >= m_header->rulesAmount)
+	{
+		return QString();
+	}
+
+	const Rule &rule = m_rules[index];
+	QString text;
+
+	if (rule.flags & ExceptionFlag)
+	{
+		text.append(QLatin1String("@@"));
+	}
+
+	if (rule.flags & DomainCheckFlag)
+	{
+		text.append(QLatin1String("||"));
+	}
+	else if (rule.flags & StartAnchoredFlag)
+	{
+		text.append(QLatin1Char('|'));
+	}
+
+	text.append(QString::fromUtf8(getString(rule.pattern)));
+
+	if (rule.flags & EndAnchoredFlag)
+	{
+		text.append(QLatin1Char('|'));
+	}
+
+	QStringList options;
+
+	if (rule.ruleOption & ContentBlockingList::ThirdPartyOption)
+	{
+		options.append(QLatin1String((rule.exceptionRuleOption & ContentBlockingList::ThirdPartyOption) ? "~third-party" : "third-party"));
+	}
+
+	if (rule.ruleOption & ContentBlockingList::StyleSheetOption)
+	{
+		options.append(QLatin1String((rule.exceptionRuleOption & ContentBlockingList::StyleSheetOption) ? "~stylesheet" : "stylesheet"));
+	}
+
+	if (rule.ruleOption & ContentBlockingList::ScriptOption)
+	{
+		options.append(QLatin1String((rule.exceptionRuleOption & ContentBlockingList::ScriptOption) ? "~script" : "script"));
+	}
+
+	if (rule.ruleOption & ContentBlockingList::ImageOption)
+	{
+		options.append(QLatin1String((rule.exceptionRuleOption & ContentBlockingList::ImageOption) ? "~image" : "image"));
+	}
+
+	if (rule.ruleOption & ContentBlockingList::ObjectOption)
+	{
+		options.append(QLatin1String((rule.exceptionRuleOption & ContentBlockingList::ObjectOption) ? "~object" : "object"));
+	}
+
+	if (rule.ruleOption & ContentBlockingList::XmlHttpRequestOption)
+	{
+		options.append(QLatin1String((rule.exceptionRuleOption & ContentBlockingList::XmlHttpRequestOption) ? "~xmlhttprequest" : "xmlhttprequest"));
+	}
+
+	QStringList domains;
+
+	for (quint32 i = 0; i < rule.blockedDomainsAmount; ++i)
+	{
+		domains.append(QString::fromUtf8(getString(m_domains[rule.firstBlockedDomain + i])));
+	}
+
+	for (quint32 i = 0; i < rule.allowedDomainsAmount; ++i)
+	{
+		domains.append(QLatin1Char('~') + QString::fromUtf8(getString(m_domains[rule.firstAllowedDomain + i])));
+	}
+
+	if (!domains.isEmpty())
+	{
+		options.append(QLatin1String("domain=") + domains.join(QLatin1Char('|')));
+	}
+
+	if (!options.isEmpty())
+	{
+		text.append(QLatin1Char('$') + options.join(QLatin1Char(',')));
+	}
+
+	return text;
+}
+
+qint64 ContentBlockingMatcher::getSize() const
+{
+	return m_size;
+}
+
+int ContentBlockingMatcher::getRulesAmount() const
+{
+	return (m_header ? int(m_header->rulesAmount) : 0);
+}
+
+int ContentBlockingMatcher::getSkippedRulesAmount() const
+{
+	return (m_header ? int(m_header->skippedRulesAmount) : 0);
+}
+
+quint32 ContentBlockingMatcher::appendSection(QByteArray &data, const void *section, int size)
+{
+	while (data.size() % 4 != 0)
+	{
+		data.append('\0');
+	}
+
+	const quint32 offset = data.size();
+
+	if (size > 0)
+	{
+		data.append(reinterpret_cast<const char*>(section), size);
+	}
+
+	return offset;
+}
+
+int ContentBlockingMatcher::findTransition(int state, uchar value) const
+{
+	int first = m_states[state].firstTransition;
+	int last = (first + m_states[state].transitionsAmount - 1);
+
+	while (first <= last)
+	{
+		const int middle = ((first + last) / 2);
+		const uchar middleValue = m_transitionValues[middle];
+
+		if (middleValue == value)
+		{
+			return m_transitionStates[middle];
+		}
+
+		if (middleValue < value)
+		{
+			first = (middle + 1);
+		}
+		else
+		{
+			last = (middle - 1);
+		}
+	}
+
+	return -1;
+}
+
+bool ContentBlockingMatcher::resolveDomainExceptions(const QByteArray &host, quint32 firstDomain, quint32 domainsAmount) const
+{
+	for (quint32 i = 0; i < domainsAmount; ++i)
+	{
+		if (host.contains(getString(m_domains[firstDomain + i])))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool ContentBlockingMatcher::resolveRuleOptions(const Rule &rule, const MatchContext &context) const
+{
+	if (rule.blockedDomainsAmount > 0 && !resolveDomainExceptions(context.baseHostData, rule.firstBlockedDomain, rule.blockedDomainsAmount))
+	{
+		return false;
+	}
+
+	if (rule.allowedDomainsAmount > 0 && resolveDomainExceptions(context.baseHostData, rule.firstAllowedDomain, rule.allowedDomainsAmount))
+	{
+		return false;
+	}
+
+	if (rule.ruleOption & ContentBlockingList::ThirdPartyOption)
+	{
+		const bool isThirdParty = PublicSuffixManager::isThirdParty(context.host, context.baseHost);
+
+		if (isThirdParty == ((rule.exceptionRuleOption & ContentBlockingList::ThirdPartyOption) != 0))
+		{
+			return false;
+		}
+	}
+
+	const int typeOptions = (rule.ruleOption & ~ContentBlockingList::ThirdPartyOption);
+
+	if (typeOptions == ContentBlockingList::NoOption)
+	{
+		return true;
+	}
+
+	const QString url = context.request->url().url();
+	const QByteArray requestHeader = context.request->rawHeader(QByteArray("Accept"));
+	int requestTypes = ContentBlockingList::NoOption;
+
+	if (requestHeader.contains(QByteArray("image/")) || url.endsWith(QLatin1String(".png")) || url.endsWith(QLatin1String(".jpg")) || url.endsWith(QLatin1String(".gif")))
+	{
+		requestTypes |= ContentBlockingList::ImageOption;
+	}
+
+	if (requestHeader.contains(QByteArray("script/")) || url.endsWith(QLatin1String(".js")))
+	{
+		requestTypes |= ContentBlockingList::ScriptOption;
+	}
+
+	if (requestHeader.contains(QByteArray("text/css")) || url.endsWith(QLatin1String(".css")))
+	{
+		requestTypes |= ContentBlockingList::StyleSheetOption;
+	}
+
+	if (requestHeader.contains(QByteArray("object")))
+	{
+		requestTypes |= ContentBlockingList::ObjectOption;
+	}
+
+	if (context.request->rawHeader(QByteArray("X-Requested-With")) == QByteArray("XMLHttpRequest"))
+	{
+		requestTypes |= ContentBlockingList::XmlHttpRequestOption;
+	}
+
+	const int includedTypes = (typeOptions & ~rule.exceptionRuleOption);
+	const int excludedTypes = (typeOptions & rule.exceptionRuleOption);
+
+	if (includedTypes != 0 && (requestTypes & includedTypes) == 0)
+	{
+		return false;
+	}
+
+	return (excludedTypes == 0 || (requestTypes & excludedTypes) == 0);
+}
+
+bool ContentBlockingMatcher::resolveRule(int index, const MatchContext &context, int &matchedRule) const
+{
+	const Rule &rule = m_rules[index];
+	const bool isException = (rule.flags & ExceptionFlag);
+
+	if ((matchedRule >= 0 && !isException) || !checkRuleMatch(rule, context))
+	{
+		return false;
+	}
+
+	matchedRule = index;
+
+	return isException;
+}
+
+bool ContentBlockingMatcher::checkRuleMatch(const Rule &rule, const MatchContext &context) const
+{
+	const bool isStartAnchored = (rule.flags & StartAnchoredFlag);
+	const bool isEndAnchored = (rule.flags & EndAnchoredFlag);
+
+	if (rule.flags & LiteralFlag)
+	{
+		if ((rule.flags & DomainCheckFlag) && !isDomainMatch(rule.domain, context.hostData))
+		{
+			return false;
+		}
+	}
+	else if (rule.flags & DomainCheckFlag)
+	{
+		bool isMatched = false;
+
+		for (int i = context.hostStart; i < context.hostEnd; ++i)
+		{
+			if ((i == context.hostStart || context.url.at(i - 1) == '.') && checkWildcardMatch((m_strings + rule.pattern.offset), rule.pattern.length, context.url, i, true, isEndAnchored))
+			{
+				isMatched = true;
+
+				break;
+			}
+		}
+
+		if (!isMatched)
+		{
+			return false;
+		}
+	}
+	else if (!checkWildcardMatch((m_strings + rule.pattern.offset), rule.pattern.length, context.url, 0, isStartAnchored, isEndAnchored))
+	{
+		return false;
+	}
+
+	return resolveRuleOptions(rule, context);
+}
+
+bool ContentBlockingMatcher::isDomainMatch(const StringReference &domain, const QByteArray &host) const
+{
+	const int position = (host.size() - int(domain.length));
+
+	if (domain.length == 0 || position < 0 || (position > 0 && host.at(position - 1) != '.'))
+	{
+		return false;
+	}
+
+	return (memcmp((m_strings + domain.offset), (host.constData() + position), domain.length) == 0);
+}
+
+bool ContentBlockingMatcher::checkWildcardMatch(const char *pattern, int patternLength, const QByteArray &url, int position, bool isStartAnchored, bool isEndAnchored)
+{
+	int patternPosition = 0;
+	int urlPosition = position;
+	int wildcardPatternPosition = (isStartAnchored ? -1 : 0);
+	int wildcardUrlPosition = position;
+
+	while (true)
+	{
+		if (patternPosition == patternLength)
+		{
+			if (!isEndAnchored || urlPosition == url.length())
+			{
+				return true;
+			}
+		}
+		else if (pattern[patternPosition] == '*')
+		{
+			++patternPosition;
+
+			wildcardPatternPosition = patternPosition;
+			wildcardUrlPosition = urlPosition;
+
+			continue;
+		}
+		else if (urlPosition < url.length() && ((pattern[patternPosition] == '^') ? isSeparator(url.at(urlPosition)) : (pattern[patternPosition] == url.at(urlPosition))))
+		{
+			++patternPosition;
+			++urlPosition;
+
+			continue;
+		}
+		else if (urlPosition == url.length() && pattern[patternPosition] == '^')
+		{
+			++patternPosition;
+
+			continue;
+		}
+
+		if (wildcardPatternPosition < 0 || wildcardUrlPosition >= url.length())
+		{
+			return false;
+		}
+
+		++wildcardUrlPosition;
+
+		patternPosition = wildcardPatternPosition;
+		urlPosition = wildcardUrlPosition;
+	}
+
+	return false;
+}
+
+bool ContentBlockingMatcher::isDataValid() const
+{
+	const qint64 statesAmount = m_header->statesAmount;
+	const qint64 rulesAmount = m_header->rulesAmount;
+	QVector<int> depths(statesAmount, -1);
+	QVector<int> queue;
+	queue.reserve(statesAmount);
+	queue.append(0);
+
+	depths[0] = 0;
+
+	for (int i = 0; i < queue.count(); ++i)
+	{
+		const State &state = m_states[queue.at(i)];
+
+		if (state.firstTransition < 0 || state.transitionsAmount < 0 || (qint64(state.firstTransition) + state.transitionsAmount) > qint64(m_header->transitionsAmount))
+		{
+			return false;
+		}
+
+		for (int j = state.firstTransition; j < (state.firstTransition + state.transitionsAmount); ++j)
+		{
+			const qint32 child = m_transitionStates[j];
+
+			if ((j > state.firstTransition && m_transitionValues[j] <= m_transitionValues[j - 1]) || child <= 0 || child >= statesAmount || depths.at(child) >= 0)
+			{
+				return false;
+			}
+
+			depths[child] = (depths.at(queue.at(i)) + 1);
+
+			queue.append(child);
+		}
+	}
+
+	if (queue.count() != statesAmount || m_states[0].failure != 0)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < statesAmount; ++i)
+	{
+		const State &state = m_states[i];
+
+		if (state.rule >= rulesAmount || state.failure < 0 || state.failure >= statesAmount || state.output >= statesAmount)
+		{
+			return false;
+		}
+
+		if (i > 0 && (depths.at(state.failure) >= depths.at(i) || (state.output > 0 && depths.at(state.output) >= depths.at(i))))
+		{
+			return false;
+		}
+	}
+
+	for (quint32 i = 0; i < m_header->rulesAmount; ++i)
+	{
+		const Rule &rule = m_rules[i];
+
+		if (rule.nextRule >= qint32(i) || !isStringValid(rule.pattern) || !isStringValid(rule.domain) || (qint64(rule.firstBlockedDomain) + rule.blockedDomainsAmount) > qint64(m_header->domainsAmount) || (qint64(rule.firstAllowedDomain) + rule.allowedDomainsAmount) > qint64(m_header->domainsAmount))
+		{
+			return false;
+		}
+	}
+
+	for (quint32 i = 0; i < m_header->domainsAmount; ++i)
+	{
+		if (!isStringValid(m_domains[i]))
+		{
+			return false;
+		}
+	}
+
+	for (quint32 i = 0; i < m_header->bucketsAmount; ++i)
+	{
+		if ((i > 0 && m_buckets[i].hash <= m_buckets[i - 1].hash) || (qint64(m_buckets[i].firstRule) + m_buckets[i].rulesAmount) > qint64(m_header->bucketRulesAmount))
+		{
+			return false;
+		}
+	}
+
+	for (quint32 i = 0; i < m_header->bucketRulesAmount; ++i)
+	{
+		if (m_bucketRules[i] >= m_header->rulesAmount)
+		{
+			return false;
+		}
+	}
+
+	for (quint32 i = 0; i < m_header->untokenizedRulesAmount; ++i)
+	{
+		if (m_untokenizedRules[i] >= m_header->rulesAmount)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool ContentBlockingMatcher::isStringValid(const StringReference &reference) const
+{
+	return ((qint64(reference.offset) + reference.length) <= qint64(m_header->stringsLength));
+}
+
+bool ContentBlockingMatcher::isSectionValid(quint32 offset, quint32 amount, quint32 elementSize, qint64 dataSize)
+{
+	return (offset % 4 == 0 && (qint64(offset) + (qint64(amount) * elementSize)) <= dataSize);
+}
+
+bool ContentBlockingMatcher::isTokenCharacter(uchar value)
+{
+	return ((value >= 'a' && value <= 'z') || (value >= '0' && value <= '9') || value == '%');
+}
+
+bool ContentBlockingMatcher::isSeparator(uchar value)
+{
+	return !(isTokenCharacter(value) || (value >= 'A' && value <= 'Z') || value == '_' || value == '-' || value == '.' || value > 127);
+}
+
+int ContentBlockingMatcher::findMatchingRule(const MatchContext &context) const
+{
+	int matchedRule = -1;
+
+	for (int rule = m_states[0].rule; rule >= 0; rule = m_rules[rule].nextRule)
+	{
+		if (resolveRule(rule, context, matchedRule))
+		{
+			return matchedRule;
+		}
+	}
+
+	int state = 0;
+
+	for (int i = 0; i < context.url.length(); ++i)
+	{
+		const uchar value = context.url.at(i);
+		int nextState = findTransition(state, value);
+
+		while (nextState < 0 && state != 0)
+		{
+			state = m_states[state].failure;
+			nextState = findTransition(state, value);
+		}
+
+		state = qMax(nextState, 0);
+
+		for (int matchedState = ((state != 0 && m_states[state].rule >= 0) ? state : m_states[state].output); matchedState > 0; matchedState = m_states[matchedState].output)
+		{
+			for (int rule = m_states[matchedState].rule; rule >= 0; rule = m_rules[rule].nextRule)
+			{
+				if (resolveRule(rule, context, matchedRule))
+				{
+					return matchedRule;
+				}
+			}
+		}
+	}
+
+	if (m_header->bucketsAmount > 0)
+	{
+		uint hash = 2166136261U;
+		bool isToken = false;
+
+		for (int i = 0; i <= context.url.length(); ++i)
+		{
+			const uchar value = ((i < context.url.length()) ? uchar(context.url.at(i)) : 0);
+
+			if (i < context.url.length() && isTokenCharacter(value))
+			{
+				hash = ((hash ^ value) * 16777619U);
+				isToken = true;
+
+				continue;
+			}
+
+			if (isToken)
+			{
+				const Bucket *bucket = findBucket(hash);
+
+				if (bucket)
+				{
+					for (quint32 j = 0; j < bucket->rulesAmount; ++j)
+					{
+						if (resolveRule(m_bucketRules[bucket->firstRule + j], context, matchedRule))
+						{
+							return matchedRule;
+						}
+					}
+				}
+			}
+
+			hash = 2166136261U;
+			isToken = false;
+		}
+	}
+
+	for (quint32 i = 0; i < m_header->untokenizedRulesAmount; ++i)
+	{
+		if (resolveRule(m_untokenizedRules[i], context, matchedRule))
+		{
+			return matchedRule;
+		}
+	}
+
+	return matchedRule;
+}
+
+bool ContentBlockingMatcher::isUrlBlocked(const QNetworkRequest &request, const QUrl &baseUrl, int *matchedRule) const
+{
+	if (matchedRule)
+	{
+		*matchedRule = -1;
+	}
+
+	if (!m_header)
+	{
+		return false;
+	}
+
+	MatchContext context;
+	context.request = &request;
+	context.url = request.url().url().toLower().toUtf8();
+	context.baseHost = baseUrl.host();
+	context.baseHostData = context.baseHost.toUtf8();
+	context.host = request.url().host().toLower();
+	context.hostData = context.host.toUtf8();
+	context.hostStart = (context.hostData.isEmpty() ? -1 : context.url.indexOf(context.hostData, qMax(0, context.url.indexOf("://"))));
+	context.hostEnd = ((context.hostStart < 0) ? -1 : (context.hostStart + context.hostData.size()));
+
+	const int rule = findMatchingRule(context);
+
+	if (matchedRule)
+	{
+		*matchedRule = rule;
+	}
+
+	return (rule >= 0 && !(m_rules[rule].flags & ExceptionFlag));
+}
+
+bool ContentBlockingMatcher::isValid() const
+{
+	return (m_header != NULL);
+}
+
+bool ContentBlockingMatcher::save(const QString &path) const
+{
+	if (!m_header)
+	{
+		return false;
+	}
+
+	QSaveFile file(path);
+
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(m_data), m_size);
+
+	return file.commit();
+}
+
+}
@@ -0,0 +1,179 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2014 Jan Bajer aka bajasoft <jbajer@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#ifndef OTTER_CONTENTBLOCKINGMATCHER_H
+#define OTTER_CONTENTBLOCKINGMATCHER_H
+
+#include "ContentBlockingList.h"
+
+#include <QtCore/QFile>
+
+namespace Otter
+{
+
+class ContentBlockingMatcher
+{
+public:
+	explicit ContentBlockingMatcher(const QByteArray &data);
+	~ContentBlockingMatcher();
+
+	static ContentBlockingMatcher* load(const QString &path, const QByteArray &checksum);
+	static QByteArray compile(QVector<ContentBlockingList::ContentBlockingRule> rules, const QByteArray &checksum, const QByteArray &cosmeticData, int skippedRulesAmount = 0);
+	QString getRuleText(int index) const;
+	QByteArray getCosmeticData() const;
+	qint64 getSize() const;
+	int getRulesAmount() const;
+	int getSkippedRulesAmount() const;
+	bool isUrlBlocked(const QNetworkRequest &request, const QUrl &baseUrl, int *matchedRule = NULL) const;
+	bool isValid() const;
+	bool save(const QString &path) const;
+
+protected:
+	enum
+	{
+		CacheMagic = 0x4F544342,
+		CacheVersion = 4
+	};
+
+	enum RuleFlag
+	{
+		NoFlag = 0,
+		ExceptionFlag = 1,
+		LiteralFlag = 2,
+		StartAnchoredFlag = 4,
+		EndAnchoredFlag = 8,
+		DomainCheckFlag = 16
+	};
+
+	struct Header
+	{
+		quint32 magic;
+		quint32 version;
+		quint8 checksum[16];
+		quint32 skippedRulesAmount;
+		quint32 statesAmount;
+		quint32 statesOffset;
+		quint32 transitionsAmount;
+		quint32 transitionValuesOffset;
+		quint32 transitionStatesOffset;
+		quint32 rulesAmount;
+		quint32 rulesOffset;
+		quint32 bucketsAmount;
+		quint32 bucketsOffset;
+		quint32 bucketRulesAmount;
+		quint32 bucketRulesOffset;
+		quint32 untokenizedRulesAmount;
+		quint32 untokenizedRulesOffset;
+		quint32 domainsAmount;
+		quint32 domainsOffset;
+		quint32 stringsLength;
+		quint32 stringsOffset;
+		quint32 cosmeticDataLength;
+		quint32 cosmeticDataOffset;
+	};
+
+	struct State
+	{
+		qint32 failure;
+		qint32 output;
+		qint32 rule;
+		qint32 firstTransition;
+		qint32 transitionsAmount;
+	};
+
+	struct StringReference
+	{
+		quint32 offset;
+		quint32 length;
+	};
+
+	struct Rule
+	{
+		StringReference pattern;
+		StringReference domain;
+		quint32 firstBlockedDomain;
+		quint32 blockedDomainsAmount;
+		quint32 firstAllowedDomain;
+		quint32 allowedDomainsAmount;
+		qint32 nextRule;
+		quint16 ruleOption;
+		quint16 exceptionRuleOption;
+		quint32 flags;
+	};
+
+	struct Bucket
+	{
+		quint32 hash;
+		quint32 firstRule;
+		quint32 rulesAmount;
+	};
+
+	struct MatchContext
+	{
+		const QNetworkRequest *request;
+		QByteArray url;
+		QByteArray baseHostData;
+		QByteArray hostData;
+		QString baseHost;
+		QString host;
+		int hostStart;
+		int hostEnd;
+	};
+
+	ContentBlockingMatcher();
+
+	void setData(const uchar *data, qint64 size);
+	const Bucket* findBucket(uint hash) const;
+	QByteArray getString(const StringReference &reference) const;
+	int findTransition(int state, uchar value) const;
+	int findMatchingRule(const MatchContext &context) const;
+	bool resolveDomainExceptions(const QByteArray &host, quint32 firstDomain, quint32 domainsAmount) const;
+	bool resolveRuleOptions(const Rule &rule, const MatchContext &context) const;
+	bool resolveRule(int index, const MatchContext &context, int &matchedRule) const;
+	bool checkRuleMatch(const Rule &rule, const MatchContext &context) const;
+	bool isDomainMatch(const StringReference &domain, const QByteArray &host) const;
+	bool isDataValid() const;
+	bool isStringValid(const StringReference &reference) const;
+	static StringReference appendString(QByteArray &strings, const QByteArray &string);
+	static quint32 appendSection(QByteArray &data, const void *section, int size);
+	static bool isSectionValid(quint32 offset, quint32 amount, quint32 elementSize, qint64 dataSize);
+	static bool checkWildcardMatch(const char *pattern, int patternLength, const QByteArray &url, int position, bool isStartAnchored, bool isEndAnchored);
+	static bool isTokenCharacter(uchar value);
+	static bool isSeparator(uchar value);
+
+private:
+	QFile *m_file;
+	QByteArray m_buffer;
+	const uchar *m_data;
+	const Header *m_header;
+	const State *m_states;
+	const uchar *m_transitionValues;
+	const qint32 *m_transitionStates;
+	const Rule *m_rules;
+	const Bucket *m_buckets;
+	const quint32 *m_bucketRules;
+	const quint32 *m_untokenizedRules;
+	const StringReference *m_domains;
+	const char *m_strings;
+	qint64 m_size;
+};
+
+}
+
+#endif
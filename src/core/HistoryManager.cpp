@@ -18,14 +18,17 @@
 **************************************************************************/
 
 #include "HistoryManager.h"
+#include "Console.h"
+#include "HistoryWriter.h"
 #include "SessionsManager.h"
 #include "SettingsManager.h"
 
-#include <QtCore/QBuffer>
+#include <QtCore/QCryptographicHash>
 #include <QtCore/QFile>
 #include <QtCore/QTextStream>
 #include <QtCore/QTimerEvent>
 #include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlError>
 #include <QtSql/QSqlField>
 #include <QtSql/QSqlQuery>
 #include <QtSql/QSqlResult>
@@ -34,18 +37,47 @@ namespace Otter
 {
 
 HistoryManager* HistoryManager::m_instance = NULL;
+QCache<qint64, QIcon> HistoryManager::m_icons(100);
+QHash<qint64, QUrl> HistoryManager::m_entryLocations;
+QSet<qint64> HistoryManager::m_removedEntries;
+QHash<quint64, int> HistoryManager::m_visitedLocations;
+QHash<int, QSqlQuery*> HistoryManager::m_statements;
+qint64 HistoryManager::m_nextEntry = 0;
+bool HistoryManager::m_visitedLocationsLoaded = false;
 bool HistoryManager::m_enabled = false;
+bool HistoryManager::m_isSearchAvailable = false;
 bool HistoryManager::m_storeFavicons = true;
 
 HistoryManager::HistoryManager(QObject *parent) : QObject(parent),
+	m_writer(new HistoryWriter()),
+	m_writerThread(new QThread(this)),
 	m_cleanupTimer(0)
 {
+	m_writer->moveToThread(m_writerThread);
+	m_writerThread->start(QThread::LowPriority);
+
 	m_dayTimer = startTimer(QTime::currentTime().msecsTo(QTime(23, 59, 59, 999)));
 
 	optionChanged(QLatin1String("History/RememberBrowsing"));
 	optionChanged(QLatin1String("History/StoreFavicons"));
 
 	connect(SettingsManager::getInstance(), SIGNAL(valueChanged(QString,QVariant)), this, SLOT(optionChanged(QString)));
+	connect(m_writer, SIGNAL(recordWritten(qint64,bool)), this, SLOT(recordWritten(qint64,bool)));
+	connect(m_writer, SIGNAL(recordRemoved(qint64,QUrl,quint64)), this, SLOT(recordRemoved(qint64,QUrl,quint64)));
+	connect(m_writer, SIGNAL(locationReplaced(quint64)), this, SLOT(locationReplaced(quint64)));
+	connect(m_writer, SIGNAL(recordsCleared(int)), this, SLOT(recordsCleared(int)));
+	connect(m_writer, SIGNAL(maintenanceFailed(QString)), this, SLOT(maintenanceFailed(QString)));
+	connect(m_writerThread, SIGNAL(finished()), m_writer, SLOT(deleteLater()));
+}
+
+HistoryManager::~HistoryManager()
+{
+	m_writer->flush();
+
+	clearStatements();
+
+	m_writerThread->quit();
+	m_writerThread->wait();
 }
 
 void HistoryManager::createInstance(QObject *parent)
@@ -64,37 +96,21 @@ void HistoryManager::timerEvent(QTimerEvent *event)
 
 		m_cleanupTimer = 0;
 
-		QSqlDatabase database = QSqlDatabase::database(QLatin1String("browsingHistory"));
-
-		if (!database.isValid())
+		if (!m_enabled)
 		{
 			return;
 		}
 
-		QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-		query.prepare(QLatin1String("SELECT COUNT(*) AS \"amount\" FROM \"visits\";"));
-		query.exec();
-
-		if (query.next())
-		{
-			const int amount = query.record().field(QLatin1String("amount")).value().toInt();
-
-			if (amount > SettingsManager::getValue(QLatin1String("History/BrowsingLimitAmountGlobal")).toInt())
-			{
-				removeOldEntries();
-			}
-		}
-
-		database.exec(QLatin1String("DELETE FROM \"icons\" WHERE \"id\" NOT IN(SELECT DISTINCT \"icon\" FROM \"visits\");"));
-		database.exec(QLatin1String("DELETE FROM \"locations\" WHERE \"id\" NOT IN(SELECT DISTINCT \"location\" FROM \"visits\");"));
-		database.exec(QLatin1String("DELETE FROM \"hosts\" WHERE \"id\" NOT IN(SELECT DISTINCT \"host\" FROM \"locations\");"));
-		database.exec(QLatin1String("VACUUM;"));
+		m_writer->scheduleMaintenance(SettingsManager::getValue(QLatin1String("History/BrowsingLimitAmountGlobal")).toInt(), SettingsManager::getValue(QLatin1String("History/BrowsingLimitPeriod")).toInt());
 	}
 	else if (event->timerId() == m_dayTimer)
 	{
 		killTimer(m_dayTimer);
 
-		removeOldEntries(QDateTime::currentDateTime().addDays(SettingsManager::getValue(QLatin1String("History/BrowsingLimitPeriod")).toInt()));
+		if (m_enabled)
+		{
+			m_writer->scheduleMaintenance(SettingsManager::getValue(QLatin1String("History/BrowsingLimitAmountGlobal")).toInt(), SettingsManager::getValue(QLatin1String("History/BrowsingLimitPeriod")).toInt());
+		}
 
 		emit dayChanged();
 
@@ -110,43 +126,17 @@ void HistoryManager::scheduleCleanup()
 	}
 }
 
-void HistoryManager::removeOldEntries(const QDateTime &date)
+void HistoryManager::clearHistory(int period)
 {
-	int timestamp = (date.isValid() ? date.toTime_t() : 0);
-
-	if (timestamp == 0)
+	if (m_enabled)
 	{
-		QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-		query.prepare(QStringLiteral("SELECT \"visits\".\"time\" FROM \"visits\" ORDER BY \"visits\".\"time\" DESC LIMIT %1, 1;").arg(SettingsManager::getValue(QLatin1String("History/BrowsingLimitAmountGlobal")).toInt()));
-		query.exec();
+		m_instance->m_writer->clearRecords(period);
 
-		if (query.next())
-		{
-			timestamp = query.record().field(QLatin1String("time")).value().toInt();
-		}
-
-		if (timestamp == 0)
-		{
-			return;
-		}
-	}
-
-	QList<qint64> entries;
-	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	query.prepare(QLatin1String("SELECT \"visits\".\"id\" FROM \"visits\" WHERE \"visits\".\"time\" <= ?;"));
-	query.bindValue(0, timestamp);
-	query.exec();
-
-	while (query.next())
-	{
-		entries.append(query.record().field("id").value().toLongLong());
+		return;
 	}
 
-	removeEntries(entries);
-}
+	m_icons.clear();
 
-void HistoryManager::clearHistory(int period)
-{
 	QSqlDatabase database = QSqlDatabase::database(QLatin1String("browsingHistory"));
 
 	if (period > 0 && !database.isValid())
@@ -165,6 +155,8 @@ void HistoryManager::clearHistory(int period)
 		{
 			database.exec(QStringLiteral("DELETE FROM \"visits\" WHERE \"time\" >= %1;").arg(QDateTime::currentDateTime().toTime_t() - (period * 3600)));
 
+			clearVisitedLocations();
+
 			m_instance->scheduleCleanup();
 		}
 		else
@@ -173,12 +165,17 @@ void HistoryManager::clearHistory(int period)
 			database.exec(QLatin1String("DELETE FROM \"locations\";"));
 			database.exec(QLatin1String("DELETE FROM \"hosts\";"));
 			database.exec(QLatin1String("DELETE FROM \"icons\";"));
+			database.exec(QLatin1String("PRAGMA auto_vacuum = INCREMENTAL;"));
 			database.exec(QLatin1String("VACUUM;"));
+
+			clearVisitedLocations();
 		}
 	}
 	else if (QFile::exists(path))
 	{
 		QFile::remove(path);
+
+		clearVisitedLocations();
 	}
 
 	emit m_instance->cleared();
@@ -199,22 +196,40 @@ void HistoryManager::optionChanged(const QString &option)
 
 			if (!database.tables().contains(QLatin1String("visits")))
 			{
-				QFile file(QLatin1String(":/schemas/browsingHistory.sql"));
-				file.open(QIODevice::ReadOnly);
-
-				QTextStream stream(&file);
+				executeScript(database, QLatin1String(":/schemas/browsingHistory.sql"));
 
-				while (!stream.atEnd())
-				{
-					database.exec(stream.readLine());
-				}
+				database.exec(QStringLiteral("PRAGMA user_version = %1;").arg(SchemaVersion));
 			}
+			else
+			{
+				updateSchema(database);
+			}
+
+			m_isSearchAvailable = (database.tables().contains(QLatin1String("visits_search")) || createSearchIndex(database));
+
+			QSqlQuery query(database);
+			query.exec(QLatin1String("SELECT MAX(\"id\") FROM \"visits\";"));
+
+			m_nextEntry = (query.next() ? query.value(0).toLongLong() : 0);
+
+			m_writer->setDatabase(database.databaseName(), SettingsManager::getValue(QLatin1String("Browser/SqliteJournalMode")).toString());
 		}
 		else if (!enabled && m_enabled)
 		{
+			m_writer->flush();
+			m_writer->setDatabase(QString(), QString());
+
+			m_entryLocations.clear();
+
+			m_isSearchAvailable = false;
+
+			clearStatements();
+
 			QSqlDatabase::database(QLatin1String("browsingHistory")).close();
 		}
 
+		clearVisitedLocations();
+
 		m_enabled = enabled;
 	}
 	else if (option == QLatin1String("History/StoreFavicons"))
@@ -223,6 +238,65 @@ void HistoryManager::optionChanged(const QString &option)
 	}
 }
 
+void HistoryManager::recordWritten(qint64 entry, bool isNew)
+{
+	if (isNew)
+	{
+		emit entryAdded(entry);
+	}
+	else
+	{
+		m_icons.clear();
+
+		scheduleCleanup();
+
+		emit entryUpdated(entry);
+	}
+}
+
+void HistoryManager::recordRemoved(qint64 entry, const QUrl &url, quint64 location)
+{
+	if (!m_removedEntries.remove(entry))
+	{
+		m_entryLocations.remove(entry);
+
+		changeVisitedLocation(location, -1);
+	}
+
+	m_icons.clear();
+
+	scheduleCleanup();
+
+	emit entryRemoved(entry);
+	emit visitRemoved(url);
+}
+
+void HistoryManager::locationReplaced(quint64 location)
+{
+	changeVisitedLocation(location, -1);
+}
+
+void HistoryManager::recordsCleared(int period)
+{
+	m_entryLocations.clear();
+	m_removedEntries.clear();
+	m_icons.clear();
+
+	clearVisitedLocations();
+
+	if (period > 0)
+	{
+		scheduleCleanup();
+	}
+
+	emit cleared();
+}
+
+void HistoryManager::maintenanceFailed(const QString &error)
+{
+	Console::addMessage(tr("Failed to compact browsing history database: %1").arg(error), OtherMessageCategory, WarningMessageLevel);
+}
+
 HistoryManager* HistoryManager::getInstance()
 {
 	return m_instance;
@@ -235,17 +309,12 @@ HistoryEntry HistoryManager::getEntry(const QSqlRecord &record)
 		return HistoryEntry();
 	}
 
-	QPixmap pixmap;
-	pixmap.loadFromData(record.field(QLatin1String("icon")).value().toByteArray());
-
 	HistoryEntry historyEntry;
-	historyEntry.url.setScheme(record.field(QLatin1String("scheme")).value().toString());
-	historyEntry.url.setHost(record.field(QLatin1String("host")).value().toString());
-	historyEntry.url.setPath(record.field(QLatin1String("path")).value().toString());
+	historyEntry.url = getLocationUrl(record.field(QLatin1String("scheme")).value().toString(), record.field(QLatin1String("host")).value().toString(), record.field(QLatin1String("path")).value().toString());
 	historyEntry.title = record.field(QLatin1String("title")).value().toString();
 	historyEntry.time = QDateTime::fromTime_t(record.field(QLatin1String("time")).value().toInt(), Qt::LocalTime);
-	historyEntry.icon = QIcon(pixmap);
 	historyEntry.identifier = record.field(QLatin1String("id")).value().toLongLong();
+	historyEntry.icon = record.field(QLatin1String("icon")).value().toLongLong();
 	historyEntry.visits = record.field(QLatin1String("visits")).value().toInt();
 	historyEntry.typed = record.field(QLatin1String("typed")).value().toBool();
 
@@ -254,24 +323,60 @@ HistoryEntry HistoryManager::getEntry(const QSqlRecord &record)
 
 HistoryEntry HistoryManager::getEntry(qint64 entry)
 {
+	QSqlQuery *query = getStatement(EntryStatement);
+
+	if (!query)
+	{
+		return HistoryEntry();
+	}
+
+	query->bindValue(0, entry);
+	query->exec();
+
+	const HistoryEntry historyEntry = (query->first() ? getEntry(query->record()) : HistoryEntry());
+
+	query->finish();
+
+	return historyEntry;
+}
+
+QList<HistoryEntry> HistoryManager::getEntries(bool typed)
+{
+	QList<HistoryEntry> entries;
 	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	query.prepare(QLatin1String("SELECT \"visits\".\"id\", \"visits\".\"title\", \"locations\".\"scheme\", \"locations\".\"path\", \"hosts\".\"host\", \"icons\".\"icon\", \"visits\".\"time\", \"visits\".\"typed\" FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" LEFT JOIN \"icons\" ON \"visits\".\"icon\" = \"icons\".\"id\" WHERE \"visits\".\"id\" = ?;"));
-	query.bindValue(0, entry);
+	query.prepare(QLatin1String("SELECT \"visits\".\"id\", \"visits\".\"title\", \"locations\".\"scheme\", \"locations\".\"path\", \"hosts\".\"host\", \"visits\".\"icon\", \"visits\".\"time\", \"visits\".\"typed\" FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\"") + (typed ? QLatin1String(" \"visits\".\"typed\" = 1") : QString()) + QLatin1String(" ORDER BY \"visits\".\"time\" DESC;"));
 	query.exec();
 
-	if (query.first())
+	while (query.next())
 	{
-		return getEntry(query.record());
+		entries.append(getEntry(query.record()));
 	}
 
-	return HistoryEntry();
+	return entries;
 }
 
-QList<HistoryEntry> HistoryManager::getEntries(bool typed)
+QList<HistoryEntry> HistoryManager::getTopEntries(int amount)
+{
+	QList<HistoryEntry> entries;
+	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
+	query.prepare(QLatin1String("SELECT \"visits\".\"id\", \"visits\".\"title\", \"visits\".\"icon\", \"locations\".\"scheme\", \"locations\".\"path\", \"hosts\".\"host\", \"statistics\".\"time\", (\"statistics\".\"typed\" > 0) AS \"typed\", \"statistics\".\"visits\" FROM (SELECT * FROM \"statistics\" ORDER BY \"visits\" DESC, \"time\" DESC LIMIT ?) AS \"statistics\" LEFT JOIN \"visits\" ON \"visits\".\"id\" = (SELECT \"id\" FROM \"visits\" WHERE \"location\" = \"statistics\".\"location\" ORDER BY \"time\" DESC LIMIT 1) LEFT JOIN \"locations\" ON \"statistics\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" ORDER BY \"statistics\".\"visits\" DESC, \"statistics\".\"time\" DESC;"));
+	query.bindValue(0, amount);
+	query.exec();
+
+	while (query.next())
+	{
+		entries.append(getEntry(query.record()));
+	}
+
+	return entries;
+}
+
+QList<HistoryEntry> HistoryManager::getLocations()
 {
 	QList<HistoryEntry> entries;
 	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	query.prepare(QLatin1String("SELECT \"visits\".\"id\", \"visits\".\"title\", \"locations\".\"scheme\", \"locations\".\"path\", \"hosts\".\"host\", \"icons\".\"icon\", \"visits\".\"time\", \"visits\".\"typed\" FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" LEFT JOIN \"icons\" ON \"visits\".\"icon\" = \"icons\".\"id\"") + (typed ? QLatin1String(" \"visits\".\"typed\" = 1") : QString()) + QLatin1String(" ORDER BY \"visits\".\"time\" DESC;"));
+	query.setForwardOnly(true);
+	query.prepare(QLatin1String("SELECT \"locations\".\"scheme\", \"locations\".\"path\", \"hosts\".\"host\", \"statistics\".\"time\", (\"statistics\".\"typed\" > 0) AS \"typed\", \"statistics\".\"visits\" FROM \"statistics\" LEFT JOIN \"locations\" ON \"statistics\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\";"));
 	query.exec();
 
 	while (query.next())
@@ -282,83 +387,317 @@ QList<HistoryEntry> HistoryManager::getEntries(bool typed)
 	return entries;
 }
 
-qint64 HistoryManager::getRecord(const QLatin1String &table, const QVariantHash &values, bool canCreate)
+QIcon HistoryManager::getIcon(qint64 icon)
 {
-	const QStringList keys = values.keys();
-	QStringList placeholders;
+	if (icon <= 0)
+	{
+		return QIcon();
+	}
+
+	QIcon *cachedIcon = m_icons.object(icon);
 
-	for (int i = 0; i < keys.count(); ++i)
+	if (cachedIcon)
 	{
-		placeholders.append(QString('?'));
+		return *cachedIcon;
 	}
 
-	QSqlQuery selectQuery(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	selectQuery.prepare(QStringLiteral("SELECT \"id\" FROM \"%1\" WHERE \"%2\" = ?;").arg(table).arg(keys.join(QLatin1String("\" = ? AND \""))));
+	QSqlQuery *query = getStatement(IconStatement);
 
-	for (int i = 0; i < keys.count(); ++i)
+	if (!query)
 	{
-		selectQuery.bindValue(i, values[keys.at(i)]);
+		return QIcon();
 	}
 
-	selectQuery.exec();
+	query->bindValue(0, icon);
+	query->exec();
 
-	if (selectQuery.first())
+	const QByteArray data = (query->first() ? query->value(0).toByteArray() : QByteArray());
+
+	query->finish();
+
+	if (data.isEmpty())
 	{
-		return selectQuery.record().field(QLatin1String("id")).value().toLongLong();
+		return QIcon();
 	}
 
-	if (!canCreate)
+	QPixmap pixmap;
+	pixmap.loadFromData(data);
+
+	const QIcon decodedIcon(pixmap);
+
+	m_icons.insert(icon, new QIcon(decodedIcon));
+
+	return decodedIcon;
+}
+
+qint64 HistoryManager::getIconHash(const QImage &icon)
+{
+	const QImage image = icon.convertToFormat(QImage::Format_ARGB32);
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	hash.addData(QByteArray::number(image.width()) + 'x' + QByteArray::number(image.height()));
+
+	for (int i = 0; i < image.height(); ++i)
 	{
-		return -1;
+		hash.addData(reinterpret_cast<const char*>(image.constScanLine(i)), (image.width() * 4));
 	}
 
-	QSqlQuery insertQuery(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	insertQuery.prepare(QStringLiteral("INSERT INTO \"%1\" (\"%2\") VALUES(%3);").arg(table).arg(keys.join(QLatin1String("\", \""))).arg(placeholders.join(QLatin1String(", "))));
+	const QByteArray result = hash.result();
+	qint64 value = 0;
 
-	for (int i = 0; i < keys.count(); ++i)
+	for (int i = 0; i < 8; ++i)
 	{
-		insertQuery.bindValue(i, values[keys.at(i)]);
+		value = ((value << 8) | uchar(result.at(i)));
 	}
 
-	insertQuery.exec();
+	return value;
+}
+
+void HistoryManager::updateIconsTable(QSqlDatabase database)
+{
+	database.exec(QLatin1String("CREATE TABLE \"icons_hashed\" (\"id\" INTEGER PRIMARY KEY, \"hash\" INTEGER NOT NULL, \"icon\" BLOB NOT NULL);"));
+
+	QSqlQuery selectQuery(database);
+	selectQuery.exec(QLatin1String("SELECT \"id\", \"icon\" FROM \"icons\";"));
+
+	QSqlQuery insertQuery(database);
+	insertQuery.prepare(QLatin1String("INSERT INTO \"icons_hashed\" (\"id\", \"hash\", \"icon\") VALUES(?, ?, ?);"));
+
+	while (selectQuery.next())
+	{
+		const QByteArray data = selectQuery.value(1).toByteArray();
+
+		insertQuery.bindValue(0, selectQuery.value(0));
+		insertQuery.bindValue(1, getIconHash(QImage::fromData(data)));
+		insertQuery.bindValue(2, data);
+		insertQuery.exec();
+	}
 
-	return insertQuery.lastInsertId().toULongLong();
+	database.exec(QLatin1String("DROP TABLE \"icons\";"));
+	database.exec(QLatin1String("ALTER TABLE \"icons_hashed\" RENAME TO \"icons\";"));
+	database.exec(QLatin1String("CREATE INDEX \"icons_hash\" ON \"icons\" (\"hash\");"));
 }
 
-qint64 HistoryManager::getLocation(const QUrl &url, bool canCreate)
+void HistoryManager::updateSchema(QSqlDatabase database)
 {
-	QVariantHash hostsRecord;
-	hostsRecord[QLatin1String("host")] = url.host();
+	QSqlQuery query(database);
+	query.exec(QLatin1String("PRAGMA user_version;"));
+
+	const int version = (query.next() ? query.value(0).toInt() : 0);
 
+	query.finish();
+
+	for (int i = (version + 1); i <= SchemaVersion; ++i)
+	{
+		database.transaction();
+
+		if (i == 1)
+		{
+			if (!database.record(QLatin1String("icons")).contains(QLatin1String("hash")))
+			{
+				updateIconsTable(database);
+			}
+		}
+		else
+		{
+			executeScript(database, QStringLiteral(":/schemas/browsingHistory-%1.sql").arg(i));
+		}
+
+		database.exec(QStringLiteral("PRAGMA user_version = %1;").arg(i));
+
+		if (!database.commit())
+		{
+			Console::addMessage(tr("Failed to update browsing history database to version %1").arg(i), OtherMessageCategory, ErrorMessageLevel);
+
+			database.rollback();
+
+			return;
+		}
+	}
+}
+
+void HistoryManager::executeScript(QSqlDatabase database, const QString &path)
+{
+	QFile file(path);
+	file.open(QIODevice::ReadOnly);
+
+	QTextStream stream(&file);
+
+	while (!stream.atEnd())
+	{
+		const QString line = stream.readLine().trimmed();
+
+		if (!line.isEmpty())
+		{
+			database.exec(line);
+		}
+	}
+}
+
+void HistoryManager::clearStatements()
+{
+	qDeleteAll(m_statements);
+
+	m_statements.clear();
+}
+
+QSqlQuery* HistoryManager::getStatement(StatementType type)
+{
+	if (m_statements.contains(type))
+	{
+		return m_statements[type];
+	}
+
+	QSqlDatabase database = QSqlDatabase::database(QLatin1String("browsingHistory"));
+
+	if (!database.isOpen())
+	{
+		return NULL;
+	}
+
+	QSqlQuery *query = new QSqlQuery(database);
+
+	switch (type)
+	{
+		case EntryStatement:
+			query->prepare(QLatin1String("SELECT \"visits\".\"id\", \"visits\".\"title\", \"locations\".\"scheme\", \"locations\".\"path\", \"hosts\".\"host\", \"visits\".\"icon\", \"visits\".\"time\", \"visits\".\"typed\" FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" WHERE \"visits\".\"id\" = ?;"));
+
+			break;
+		case IconStatement:
+			query->prepare(QLatin1String("SELECT \"icon\" FROM \"icons\" WHERE \"id\" = ?;"));
+
+			break;
+		default:
+			break;
+	}
+
+	m_statements[type] = query;
+
+	return query;
+}
+
+bool HistoryManager::createSearchIndex(QSqlDatabase database)
+{
+	database.transaction();
+
+	if (database.exec(QLatin1String("CREATE VIRTUAL TABLE \"visits_search\" USING fts4(\"host\", \"path\", \"title\");")).lastError().isValid())
+	{
+		database.rollback();
+
+		Console::addMessage(tr("Full text search is not available, history will be searched without index"), OtherMessageCategory, WarningMessageLevel);
+
+		return false;
+	}
+
+	database.exec(QLatin1String("CREATE TRIGGER \"visits_search_insert\" AFTER INSERT ON \"visits\" BEGIN INSERT INTO \"visits_search\" (\"docid\", \"host\", \"path\", \"title\") SELECT NEW.\"id\", \"hosts\".\"host\", \"locations\".\"path\", NEW.\"title\" FROM \"locations\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" WHERE \"locations\".\"id\" = NEW.\"location\"; END;"));
+	database.exec(QLatin1String("CREATE TRIGGER \"visits_search_update\" AFTER UPDATE OF \"location\", \"title\" ON \"visits\" BEGIN DELETE FROM \"visits_search\" WHERE \"docid\" = OLD.\"id\"; INSERT INTO \"visits_search\" (\"docid\", \"host\", \"path\", \"title\") SELECT NEW.\"id\", \"hosts\".\"host\", \"locations\".\"path\", NEW.\"title\" FROM \"locations\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" WHERE \"locations\".\"id\" = NEW.\"location\"; END;"));
+	database.exec(QLatin1String("CREATE TRIGGER \"visits_search_delete\" AFTER DELETE ON \"visits\" BEGIN DELETE FROM \"visits_search\" WHERE \"docid\" = OLD.\"id\"; END;"));
+	database.exec(QLatin1String("INSERT INTO \"visits_search\" (\"docid\", \"host\", \"path\", \"title\") SELECT \"visits\".\"id\", \"hosts\".\"host\", \"locations\".\"path\", \"visits\".\"title\" FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\";"));
+
+	return database.commit();
+}
+
+QString HistoryManager::getSearchExpression(const QString &text)
+{
+	QStringList tokens;
+	QString token;
+
+	for (int i = 0; i <= text.length(); ++i)
+	{
+		if (i < text.length() && text.at(i).isLetterOrNumber())
+		{
+			token.append(text.at(i));
+		}
+		else if (!token.isEmpty())
+		{
+			tokens.append(token + QLatin1Char('*'));
+
+			token.clear();
+		}
+	}
+
+	return tokens.join(QLatin1Char(' '));
+}
+
+QString HistoryManager::getLocationPath(const QUrl &url)
+{
 	QUrl simplifiedUrl(url);
 	simplifiedUrl.setScheme(QString());
 	simplifiedUrl.setHost(QString());
 
-	QVariantHash locationsRecord;
-	locationsRecord[QLatin1String("host")] = getRecord(QLatin1String("hosts"), hostsRecord, canCreate);
-	locationsRecord[QLatin1String("scheme")] = url.scheme();
-	locationsRecord[QLatin1String("path")] = simplifiedUrl.toString(QUrl::RemovePassword | QUrl::NormalizePathSegments);
+	return simplifiedUrl.toString(QUrl::RemovePassword | QUrl::NormalizePathSegments);
+}
 
-	return getRecord(QLatin1String("locations"), locationsRecord, canCreate);
+QUrl HistoryManager::getLocationUrl(const QString &scheme, const QString &host, const QString &path)
+{
+	QUrl url;
+	url.setScheme(scheme);
+	url.setHost(host);
+	url.setPath(path);
+
+	return url;
 }
 
-qint64 HistoryManager::getIcon(const QIcon &icon, bool canCreate)
+quint64 HistoryManager::getLocationKey(const QUrl &url)
 {
-	if (!m_storeFavicons)
+	return getLocationKey(url.scheme(), url.host(), getLocationPath(url));
+}
+
+quint64 HistoryManager::getLocationKey(const QString &scheme, const QString &host, const QString &path)
+{
+	const QString location = scheme + QLatin1Char('\n') + host + QLatin1Char('\n') + path;
+
+	return ((quint64(qHash(location)) << 32) | qHash(location, 0x9E3779B9));
+}
+
+void HistoryManager::loadVisitedLocations()
+{
+	m_visitedLocations.clear();
+	m_visitedLocationsLoaded = true;
+
+	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
+	query.setForwardOnly(true);
+	query.prepare(QLatin1String("SELECT \"locations\".\"scheme\", \"locations\".\"path\", \"hosts\".\"host\", \"statistics\".\"visits\" FROM \"statistics\" LEFT JOIN \"locations\" ON \"statistics\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\";"));
+	query.exec();
+
+	while (query.next())
 	{
-		return 0;
+		m_visitedLocations[getLocationKey(query.value(0).toString(), query.value(2).toString(), query.value(1).toString())] += query.value(3).toInt();
+	}
+
+	QHash<qint64, QUrl>::const_iterator iterator;
+
+	for (iterator = m_entryLocations.constBegin(); iterator != m_entryLocations.constEnd(); ++iterator)
+	{
+		if (m_instance->m_writer->hasNewRecord(iterator.key()))
+		{
+			++m_visitedLocations[getLocationKey(iterator.value())];
+		}
 	}
+}
 
-	QByteArray data;
-	QBuffer buffer(&data);
-	buffer.open(QIODevice::WriteOnly);
+void HistoryManager::changeVisitedLocation(quint64 key, int change)
+{
+	if (!m_visitedLocationsLoaded)
+	{
+		return;
+	}
 
-	icon.pixmap(QSize(16, 16)).save(&buffer, "PNG");
+	const int visits = (m_visitedLocations.value(key, 0) + change);
 
-	QVariantHash record;
-	record[QLatin1String("icon")] = data;
+	if (visits > 0)
+	{
+		m_visitedLocations[key] = visits;
+	}
+	else
+	{
+		m_visitedLocations.remove(key);
+	}
+}
 
-	return getRecord(QLatin1String("icons"), record, canCreate);
+void HistoryManager::clearVisitedLocations()
+{
+	m_visitedLocations.clear();
+	m_visitedLocationsLoaded = false;
 }
 
 qint64 HistoryManager::addEntry(const QUrl &url, const QString &title, const QIcon &icon, bool typed)
@@ -368,30 +707,37 @@ qint64 HistoryManager::addEntry(const QUrl &url, const QString &title, const QIc
 		return -1;
 	}
 
-	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	query.prepare(QLatin1String("INSERT INTO \"visits\" (\"location\", \"icon\", \"title\", \"time\", \"typed\") VALUES(?, ?, ?, ?, ?);"));
-	query.bindValue(0, getLocation(url));
-	query.bindValue(1, getIcon(icon));
-	query.bindValue(2, title);
-	query.bindValue(3, QDateTime::currentDateTime().toTime_t());
-	query.bindValue(4, typed);
-	query.exec();
+	HistoryRecord record;
+	record.url = url;
+	record.title = title;
+	record.icon = (m_storeFavicons ? icon.pixmap(QSize(16, 16)).toImage() : QImage());
+	record.identifier = ++m_nextEntry;
+	record.time = QDateTime::currentDateTime().toTime_t();
+	record.typed = typed;
+	record.isNew = true;
 
-	if (!query.lastInsertId().isNull())
-	{
-		const qint64 entry = query.lastInsertId().toLongLong();
+	m_instance->m_writer->addRecord(record);
 
-		emit m_instance->entryAdded(entry);
+	m_entryLocations[record.identifier] = url;
 
-		return entry;
-	}
+	changeVisitedLocation(getLocationKey(url), 1);
 
-	return -1;
+	return record.identifier;
 }
 
 bool HistoryManager::hasUrl(const QUrl &url)
 {
-	return (getLocation(url, false) >= 0);
+	if (!m_enabled || !url.isValid())
+	{
+		return false;
+	}
+
+	if (!m_visitedLocationsLoaded)
+	{
+		loadVisitedLocations();
+	}
+
+	return m_visitedLocations.contains(getLocationKey(url));
 }
 
 bool HistoryManager::updateEntry(qint64 entry, const QUrl &url, const QString &title, const QIcon &icon)
@@ -408,79 +754,75 @@ bool HistoryManager::updateEntry(qint64 entry, const QUrl &url, const QString &t
 		return false;
 	}
 
-	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	query.prepare(QLatin1String("UPDATE \"visits\" SET \"location\" = ?, \"icon\" = ?, \"title\" = ? WHERE \"id\" = ?;"));
-	query.bindValue(0, getLocation(url));
-	query.bindValue(1, getIcon(icon));
-	query.bindValue(2, title);
-	query.bindValue(3, entry);
-	query.exec();
+	const bool isTracked = m_entryLocations.contains(entry);
 
-	const bool success = (query.numRowsAffected() > 0);
-
-	if (success)
+	if (isTracked)
 	{
-		m_instance->scheduleCleanup();
-
-		emit m_instance->entryUpdated(entry);
+		changeVisitedLocation(getLocationKey(m_entryLocations.value(entry)), -1);
 	}
 
-	return success;
-}
+	HistoryRecord record;
+	record.url = url;
+	record.title = title;
+	record.icon = (m_storeFavicons ? icon.pixmap(QSize(16, 16)).toImage() : QImage());
+	record.identifier = entry;
+	record.reportLocation = !isTracked;
 
-bool HistoryManager::removeEntry(qint64 entry)
-{
-	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	query.prepare(QLatin1String("DELETE FROM \"visits\" WHERE \"id\" = ?;"));
-	query.bindValue(0, entry);
-	query.exec();
+	m_instance->m_writer->addRecord(record);
 
-	const bool success = (query.numRowsAffected() > 0);
+	m_entryLocations[entry] = url;
 
-	if (success)
-	{
-		m_instance->scheduleCleanup();
+	changeVisitedLocation(getLocationKey(url), 1);
 
-		emit m_instance->entryRemoved(entry);
-	}
+	return true;
+}
 
-	return success;
+bool HistoryManager::removeEntry(qint64 entry)
+{
+	return removeEntries(QList<qint64>() << entry);
 }
 
 bool HistoryManager::removeEntries(const QList<qint64> &entries)
 {
-	QStringList list;
+	if (!m_enabled)
+	{
+		return false;
+	}
+
+	QList<qint64> removedEntries;
 
 	for (int i = 0; i < entries.count(); ++i)
 	{
-		if (entries.at(i) >= 0)
+		if (entries.at(i) < 0)
 		{
-			list.append(QString::number(entries.at(i)));
+			continue;
+		}
+
+		removedEntries.append(entries.at(i));
+
+		if (m_entryLocations.contains(entries.at(i)))
+		{
+			const QUrl url = m_entryLocations.take(entries.at(i));
+
+			changeVisitedLocation(getLocationKey(url), -1);
+
+			m_removedEntries.insert(entries.at(i));
 		}
 	}
 
-	if (list.isEmpty())
+	if (removedEntries.isEmpty())
 	{
 		return false;
 	}
 
-	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
-	query.prepare(QStringLiteral("DELETE FROM \"visits\" WHERE \"id\" IN(%1);").arg(list.join(QLatin1String(", "))));
-	query.exec();
-
-	const bool success = (query.numRowsAffected() > 0);
+	const QList<qint64> discardedEntries = m_instance->m_writer->removeRecords(removedEntries);
 
-	if (success)
+	for (int i = 0; i < discardedEntries.count(); ++i)
 	{
-		m_instance->scheduleCleanup();
-
-		for (int i = 0; i < entries.count(); ++i)
-		{
-			emit m_instance->entryRemoved(entries.at(i));
-		}
+		m_removedEntries.remove(discardedEntries.at(i));
 	}
 
-	return success;
+	return true;
 }
 
 }
@@ -20,10 +20,16 @@
 #ifndef OTTER_HISTORYMANAGER_H
 #define OTTER_HISTORYMANAGER_H
 
+#include <QtCore/QCache>
 #include <QtCore/QObject>
 #include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QThread>
 #include <QtCore/QUrl>
 #include <QtGui/QIcon>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlQuery>
 #include <QtSql/QSqlRecord>
 
 namespace Otter
@@ -34,14 +40,16 @@ struct HistoryEntry
 	QUrl url;
 	QString title;
 	QDateTime time;
-	QIcon icon;
 	qint64 identifier;
+	qint64 icon;
 	int visits;
 	bool typed;
 
-	HistoryEntry() : identifier(-1), visits(0), typed(false) {}
+	HistoryEntry() : identifier(-1), icon(0), visits(0), typed(false) {}
 };
 
+class HistoryWriter;
+
 class HistoryManager : public QObject
 {
 	Q_OBJECT
@@ -52,6 +60,9 @@ public:
 	static HistoryManager* getInstance();
 	static HistoryEntry getEntry(qint64 entry);
 	static QList<HistoryEntry> getEntries(bool typed = false);
+	static QList<HistoryEntry> getTopEntries(int amount);
+	static QList<HistoryEntry> getLocations();
+	static QIcon getIcon(qint64 icon);
 	static qint64 addEntry(const QUrl &url, const QString &title, const QIcon &icon, bool typed = false);
 	static bool hasUrl(const QUrl &url);
 	static bool updateEntry(qint64 entry, const QUrl &url, const QString &title, const QIcon &icon);
@@ -59,25 +70,63 @@ public:
 	static bool removeEntries(const QList<qint64> &entries);
 
 protected:
+	enum StatementType
+	{
+		EntryStatement = 0,
+		IconStatement = 1
+	};
+
+	enum
+	{
+		SchemaVersion = 5
+	};
+
 	explicit HistoryManager(QObject *parent = NULL);
+	~HistoryManager();
 
 	void timerEvent(QTimerEvent *event);
 	void scheduleCleanup();
-	void removeOldEntries(const QDateTime &date = QDateTime());
 	static HistoryEntry getEntry(const QSqlRecord &record);
-	static qint64 getRecord(const QLatin1String &table, const QVariantHash &values, bool canCreate = true);
-	static qint64 getLocation(const QUrl &url, bool canCreate = true);
-	static qint64 getIcon(const QIcon &icon, bool canCreate = true);
+	static quint64 getLocationKey(const QString &scheme, const QString &host, const QString &path);
+	static quint64 getLocationKey(const QUrl &url);
+	static QUrl getLocationUrl(const QString &scheme, const QString &host, const QString &path);
+	static QString getLocationPath(const QUrl &url);
+	static QString getSearchExpression(const QString &text);
+	static qint64 getIconHash(const QImage &icon);
+	static void updateIconsTable(QSqlDatabase database);
+	static void updateSchema(QSqlDatabase database);
+	static void executeScript(QSqlDatabase database, const QString &path);
+	static void clearStatements();
+	static QSqlQuery* getStatement(StatementType type);
+	static bool createSearchIndex(QSqlDatabase database);
+	static void loadVisitedLocations();
+	static void changeVisitedLocation(quint64 key, int change);
+	static void clearVisitedLocations();
 
 protected slots:
 	void optionChanged(const QString &option);
+	void recordWritten(qint64 entry, bool isNew);
+	void recordRemoved(qint64 entry, const QUrl &url, quint64 location);
+	void locationReplaced(quint64 location);
+	void recordsCleared(int period);
+	void maintenanceFailed(const QString &error);
 
 private:
+	HistoryWriter *m_writer;
+	QThread *m_writerThread;
 	int m_cleanupTimer;
 	int m_dayTimer;
 
 	static HistoryManager *m_instance;
+	static QCache<qint64, QIcon> m_icons;
+	static QHash<qint64, QUrl> m_entryLocations;
+	static QSet<qint64> m_removedEntries;
+	static QHash<quint64, int> m_visitedLocations;
+	static QHash<int, QSqlQuery*> m_statements;
+	static qint64 m_nextEntry;
+	static bool m_visitedLocationsLoaded;
 	static bool m_enabled;
+	static bool m_isSearchAvailable;
 	static bool m_storeFavicons;
 
 signals:
@@ -85,7 +134,11 @@ signals:
 	void entryAdded(qint64 entry);
 	void entryUpdated(qint64 entry);
 	void entryRemoved(qint64 entry);
+	void visitRemoved(const QUrl &url);
 	void dayChanged();
+
+friend class HistoryModel;
+friend class HistoryWriter;
 };
 
 }
@@ -0,0 +1,524 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2013 - 2014 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#include "HistoryModel.h"
+#include "Utils.h"
+
+#include <QtSql/QSqlDatabase>
+
+namespace Otter
+{
+
+HistoryModel::HistoryModel(QObject *parent) : QAbstractItemModel(parent)
+{
+	reload();
+
+	connect(HistoryManager::getInstance(), SIGNAL(cleared()), this, SLOT(reload()));
+	connect(HistoryManager::getInstance(), SIGNAL(dayChanged()), this, SLOT(reload()));
+	connect(HistoryManager::getInstance(), SIGNAL(entryAdded(qint64)), this, SLOT(addEntry(qint64)));
+	connect(HistoryManager::getInstance(), SIGNAL(entryUpdated(qint64)), this, SLOT(updateEntry(qint64)));
+	connect(HistoryManager::getInstance(), SIGNAL(entryRemoved(qint64)), this, SLOT(removeEntry(qint64)));
+}
+
+void HistoryModel::reload()
+{
+	beginResetModel();
+
+	const QDate date = QDate::currentDate();
+	QList<QDate> dates;
+	dates << date << date.addDays(-1) << date.addDays(-7) << date.addDays(-14) << date.addDays(-30) << date.addDays(-365);
+
+	QStringList titles;
+	titles << tr("Today") << tr("Yesterday") << tr("Earlier This Week") << tr("Previous Week") << tr("Earlier This Month") << tr("Earlier This Year") << tr("Older");
+
+	m_groups.clear();
+	m_groups.resize(titles.count());
+
+	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
+	query.prepare(QLatin1String("SELECT 1 FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" WHERE \"visits\".\"time\" >= ? AND \"visits\".\"time\" < ?") + getCondition() + QLatin1String(" LIMIT 1;"));
+
+	for (int i = 0; i < m_groups.count(); ++i)
+	{
+		m_groups[i].title = titles.at(i);
+		m_groups[i].start = ((i < dates.count()) ? QDateTime(dates.at(i)).toTime_t() : 0);
+		m_groups[i].end = ((i > 0) ? m_groups.at(i - 1).start : UINT_MAX);
+
+		query.bindValue(0, m_groups.at(i).start);
+		query.bindValue(1, m_groups.at(i).end);
+
+		bindFilter(query, 2);
+
+		query.exec();
+
+		m_groups[i].hasEntries = query.next();
+		m_groups[i].isComplete = !m_groups.at(i).hasEntries;
+	}
+
+	endResetModel();
+}
+
+void HistoryModel::fetchMore(const QModelIndex &parent)
+{
+	if (!canFetchMore(parent))
+	{
+		return;
+	}
+
+	HistoryGroup &group = m_groups[parent.row()];
+	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
+	query.prepare(QLatin1String("SELECT \"visits\".\"id\", \"visits\".\"title\", \"locations\".\"scheme\", \"locations\".\"path\", \"hosts\".\"host\", \"visits\".\"icon\", \"visits\".\"time\", \"visits\".\"typed\" FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" WHERE \"visits\".\"time\" >= ? AND (\"visits\".\"time\" < ? OR (\"visits\".\"time\" = ? AND \"visits\".\"id\" < ?))") + getCondition() + QStringLiteral(" ORDER BY \"visits\".\"time\" DESC, \"visits\".\"id\" DESC LIMIT %1;").arg(PageSize));
+	query.bindValue(0, group.start);
+
+	if (group.entries.isEmpty())
+	{
+		query.bindValue(1, group.end);
+		query.bindValue(2, group.end);
+		query.bindValue(3, Q_INT64_C(0));
+	}
+	else
+	{
+		query.bindValue(1, group.entries.last().time.toTime_t());
+		query.bindValue(2, group.entries.last().time.toTime_t());
+		query.bindValue(3, group.entries.last().identifier);
+	}
+
+	bindFilter(query, 4);
+
+	query.exec();
+
+	QList<HistoryEntry> entries;
+
+	while (query.next())
+	{
+		entries.append(HistoryManager::getEntry(query.record()));
+	}
+
+	group.isComplete = (entries.count() < PageSize);
+
+	if (entries.isEmpty())
+	{
+		return;
+	}
+
+	beginInsertRows(parent, group.entries.count(), (group.entries.count() + entries.count() - 1));
+
+	group.entries.append(entries);
+
+	endInsertRows();
+}
+
+void HistoryModel::setFilter(const QString &filter)
+{
+	if (filter != m_filter)
+	{
+		m_filter = filter;
+		m_searchExpression = (HistoryManager::m_isSearchAvailable ? HistoryManager::getSearchExpression(filter) : QString());
+
+		reload();
+	}
+}
+
+void HistoryModel::bindFilter(QSqlQuery &query, int position) const
+{
+	if (m_filter.isEmpty())
+	{
+		return;
+	}
+
+	if (!m_searchExpression.isEmpty())
+	{
+		query.bindValue(position, m_searchExpression);
+
+		return;
+	}
+
+	const QString pattern = QLatin1Char('%') + m_filter + QLatin1Char('%');
+
+	for (int i = 0; i < 3; ++i)
+	{
+		query.bindValue((position + i), pattern);
+	}
+}
+
+bool HistoryModel::isMatchingFilter(const HistoryEntry &entry) const
+{
+	if (m_filter.isEmpty())
+	{
+		return true;
+	}
+
+	if (m_searchExpression.isEmpty())
+	{
+		return (entry.url.toString().contains(m_filter, Qt::CaseInsensitive) || entry.title.contains(m_filter, Qt::CaseInsensitive));
+	}
+
+	const QString text = entry.url.host() + QLatin1Char(' ') + HistoryManager::getLocationPath(entry.url) + QLatin1Char(' ') + entry.title;
+	QStringList words;
+	QString word;
+
+	for (int i = 0; i <= text.length(); ++i)
+	{
+		if (i < text.length() && text.at(i).isLetterOrNumber())
+		{
+			word.append(text.at(i));
+		}
+		else if (!word.isEmpty())
+		{
+			words.append(word);
+
+			word.clear();
+		}
+	}
+
+	const QStringList tokens = m_searchExpression.split(QLatin1Char(' '), QString::SkipEmptyParts);
+
+	for (int i = 0; i < tokens.count(); ++i)
+	{
+		const QString token = tokens.at(i).left(tokens.at(i).length() - 1);
+		bool isMatching = false;
+
+		for (int j = 0; j < words.count(); ++j)
+		{
+			if (words.at(j).startsWith(token, Qt::CaseInsensitive))
+			{
+				isMatching = true;
+
+				break;
+			}
+		}
+
+		if (!isMatching)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void HistoryModel::addEntry(qint64 entry)
+{
+	const HistoryEntry historyEntry = HistoryManager::getEntry(entry);
+
+	if (historyEntry.identifier < 0 || !isMatchingFilter(historyEntry))
+	{
+		return;
+	}
+
+	const int groupRow = findGroup(historyEntry.time);
+
+	if (groupRow < 0)
+	{
+		return;
+	}
+
+	HistoryGroup &group = m_groups[groupRow];
+	int row = 0;
+
+	while (row < group.entries.count() && (group.entries.at(row).time > historyEntry.time || (group.entries.at(row).time == historyEntry.time && group.entries.at(row).identifier > historyEntry.identifier)))
+	{
+		++row;
+	}
+
+	if (!group.hasEntries)
+	{
+		group.hasEntries = true;
+
+		emit dataChanged(index(groupRow, 0), index(groupRow, 2));
+	}
+
+	if (row == group.entries.count() && !group.isComplete)
+	{
+		return;
+	}
+
+	beginInsertRows(index(groupRow, 0), row, row);
+
+	group.entries.insert(row, historyEntry);
+
+	endInsertRows();
+}
+
+void HistoryModel::updateEntry(qint64 entry)
+{
+	const QModelIndex entryIndex = findEntry(entry);
+
+	if (!entryIndex.isValid())
+	{
+		addEntry(entry);
+
+		return;
+	}
+
+	m_groups[entryIndex.parent().row()].entries[entryIndex.row()] = HistoryManager::getEntry(entry);
+
+	emit dataChanged(entryIndex, entryIndex.sibling(entryIndex.row(), 2));
+}
+
+void HistoryModel::removeEntry(qint64 entry)
+{
+	const QModelIndex entryIndex = findEntry(entry);
+
+	if (!entryIndex.isValid())
+	{
+		return;
+	}
+
+	HistoryGroup &group = m_groups[entryIndex.parent().row()];
+
+	beginRemoveRows(entryIndex.parent(), entryIndex.row(), entryIndex.row());
+
+	group.entries.removeAt(entryIndex.row());
+
+	endRemoveRows();
+
+	if (group.entries.isEmpty() && group.isComplete)
+	{
+		group.hasEntries = false;
+
+		emit dataChanged(entryIndex.parent(), entryIndex.parent().sibling(entryIndex.parent().row(), 2));
+	}
+}
+
+QModelIndex HistoryModel::index(int row, int column, const QModelIndex &parent) const
+{
+	if (column < 0 || column >= columnCount() || row < 0)
+	{
+		return QModelIndex();
+	}
+
+	if (!parent.isValid())
+	{
+		return ((row < m_groups.count()) ? createIndex(row, column, quintptr(0)) : QModelIndex());
+	}
+
+	if (parent.internalId() != 0 || parent.row() >= m_groups.count() || row >= m_groups.at(parent.row()).entries.count())
+	{
+		return QModelIndex();
+	}
+
+	return createIndex(row, column, quintptr(parent.row() + 1));
+}
+
+QModelIndex HistoryModel::parent(const QModelIndex &index) const
+{
+	if (!index.isValid() || index.internalId() == 0)
+	{
+		return QModelIndex();
+	}
+
+	return createIndex((index.internalId() - 1), 0, quintptr(0));
+}
+
+QModelIndex HistoryModel::findEntry(qint64 entry) const
+{
+	for (int i = 0; i < m_groups.count(); ++i)
+	{
+		for (int j = 0; j < m_groups.at(i).entries.count(); ++j)
+		{
+			if (m_groups.at(i).entries.at(j).identifier == entry)
+			{
+				return createIndex(j, 0, quintptr(i + 1));
+			}
+		}
+	}
+
+	return QModelIndex();
+}
+
+QVariant HistoryModel::data(const QModelIndex &index, int role) const
+{
+	if (!index.isValid())
+	{
+		return QVariant();
+	}
+
+	if (index.internalId() == 0)
+	{
+		if (index.column() != 0 || index.row() >= m_groups.count())
+		{
+			return QVariant();
+		}
+
+		if (role == Qt::DisplayRole)
+		{
+			return m_groups.at(index.row()).title;
+		}
+
+		if (role == Qt::DecorationRole)
+		{
+			return Utils::getIcon(QLatin1String("inode-directory"));
+		}
+
+		return QVariant();
+	}
+
+	const int group = (index.internalId() - 1);
+
+	if (group >= m_groups.count() || index.row() >= m_groups.at(group).entries.count())
+	{
+		return QVariant();
+	}
+
+	const HistoryEntry &entry = m_groups.at(group).entries.at(index.row());
+
+	switch (role)
+	{
+		case Qt::DisplayRole:
+		case Qt::ToolTipRole:
+			if (index.column() == 0)
+			{
+				return entry.url.toString().replace(QLatin1String("%23"), QString(QLatin1Char('#')));
+			}
+
+			if (index.column() == 1)
+			{
+				return (entry.title.isEmpty() ? tr("(Untitled)") : entry.title);
+			}
+
+			return entry.time.toString();
+		case Qt::DecorationRole:
+			if (index.column() == 0)
+			{
+				const QIcon icon = HistoryManager::getIcon(entry.icon);
+
+				return (icon.isNull() ? Utils::getIcon(QLatin1String("text-html")) : icon);
+			}
+
+			return QVariant();
+		case Qt::UserRole:
+			return entry.identifier;
+		default:
+			break;
+	}
+
+	return QVariant();
+}
+
+QVariant HistoryModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+	{
+		return QVariant();
+	}
+
+	switch (section)
+	{
+		case 0:
+			return tr("Address");
+		case 1:
+			return tr("Title");
+		case 2:
+			return tr("Date");
+		default:
+			break;
+	}
+
+	return QVariant();
+}
+
+QString HistoryModel::getCondition() const
+{
+	if (m_filter.isEmpty())
+	{
+		return QString();
+	}
+
+	if (!m_searchExpression.isEmpty())
+	{
+		return QLatin1String(" AND \"visits\".\"id\" IN(SELECT \"docid\" FROM \"visits_search\" WHERE \"visits_search\" MATCH ?)");
+	}
+
+	return QLatin1String(" AND (\"hosts\".\"host\" LIKE ? OR \"locations\".\"path\" LIKE ? OR \"visits\".\"title\" LIKE ?)");
+}
+
+QList<qint64> HistoryModel::getHostEntries(const QString &host) const
+{
+	QList<qint64> entries;
+	QSqlQuery query(QSqlDatabase::database(QLatin1String("browsingHistory")));
+	query.prepare(QLatin1String("SELECT \"visits\".\"id\" FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" WHERE \"hosts\".\"host\" = ?;"));
+	query.bindValue(0, host);
+	query.exec();
+
+	while (query.next())
+	{
+		entries.append(query.value(0).toLongLong());
+	}
+
+	return entries;
+}
+
+int HistoryModel::findGroup(const QDateTime &time) const
+{
+	const uint timestamp = time.toTime_t();
+
+	for (int i = 0; i < m_groups.count(); ++i)
+	{
+		if (timestamp >= m_groups.at(i).start && timestamp < m_groups.at(i).end)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+int HistoryModel::rowCount(const QModelIndex &parent) const
+{
+	if (!parent.isValid())
+	{
+		return m_groups.count();
+	}
+
+	if (parent.internalId() != 0 || parent.column() != 0 || parent.row() >= m_groups.count())
+	{
+		return 0;
+	}
+
+	return m_groups.at(parent.row()).entries.count();
+}
+
+int HistoryModel::columnCount(const QModelIndex &parent) const
+{
+	Q_UNUSED(parent)
+
+	return 3;
+}
+
+bool HistoryModel::canFetchMore(const QModelIndex &parent) const
+{
+	return (parent.isValid() && parent.internalId() == 0 && parent.row() < m_groups.count() && !m_groups.at(parent.row()).isComplete);
+}
+
+bool HistoryModel::hasChildren(const QModelIndex &parent) const
+{
+	if (!parent.isValid())
+	{
+		return true;
+	}
+
+	return (parent.internalId() == 0 && parent.column() == 0 && parent.row() < m_groups.count() && m_groups.at(parent.row()).hasEntries);
+}
+
+bool HistoryModel::hasEntries(int group) const
+{
+	return (group >= 0 && group < m_groups.count() && m_groups.at(group).hasEntries);
+}
+
+}
@@ -0,0 +1,91 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2013 - 2014 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#ifndef OTTER_HISTORYMODEL_H
+#define OTTER_HISTORYMODEL_H
+
+#include "HistoryManager.h"
+
+#include <QtCore/QAbstractItemModel>
+#include <QtSql/QSqlQuery>
+
+namespace Otter
+{
+
+class HistoryModel : public QAbstractItemModel
+{
+	Q_OBJECT
+
+public:
+	explicit HistoryModel(QObject *parent = NULL);
+
+	void fetchMore(const QModelIndex &parent);
+	void setFilter(const QString &filter);
+	QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+	QModelIndex parent(const QModelIndex &index) const;
+	QModelIndex findEntry(qint64 entry) const;
+	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+	QList<qint64> getHostEntries(const QString &host) const;
+	int rowCount(const QModelIndex &parent = QModelIndex()) const;
+	int columnCount(const QModelIndex &parent = QModelIndex()) const;
+	bool canFetchMore(const QModelIndex &parent) const;
+	bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+	bool hasEntries(int group) const;
+
+public slots:
+	void reload();
+
+protected:
+	enum
+	{
+		PageSize = 100
+	};
+
+	struct HistoryGroup
+	{
+		QString title;
+		QList<HistoryEntry> entries;
+		uint start;
+		uint end;
+		bool hasEntries;
+		bool isComplete;
+
+		HistoryGroup() : start(0), end(0), hasEntries(false), isComplete(false) {}
+	};
+
+	QString getCondition() const;
+	int findGroup(const QDateTime &time) const;
+	void bindFilter(QSqlQuery &query, int position) const;
+	bool isMatchingFilter(const HistoryEntry &entry) const;
+
+protected slots:
+	void addEntry(qint64 entry);
+	void updateEntry(qint64 entry);
+	void removeEntry(qint64 entry);
+
+private:
+	QVector<HistoryGroup> m_groups;
+	QString m_filter;
+	QString m_searchExpression;
+};
+
+}
+
+#endif
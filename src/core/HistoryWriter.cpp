@@ -0,0 +1,723 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2013 - 2014 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#include "HistoryWriter.h"
+#include "HistoryManager.h"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QDateTime>
+#include <QtCore/QThread>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlError>
+#include <QtSql/QSqlQuery>
+
+namespace Otter
+{
+
+HistoryWriter::HistoryWriter(QObject *parent) : QObject(parent),
+	m_timer(new QTimer(this)),
+	m_maintenanceTimer(new QTimer(this)),
+	m_limitAmount(0),
+	m_limitPeriod(0),
+	m_isScheduled(false)
+{
+	m_timer->setSingleShot(true);
+	m_timer->setInterval(1000);
+
+	m_maintenanceTimer->setSingleShot(true);
+
+	connect(m_timer, SIGNAL(timeout()), this, SLOT(writeRecords()));
+	connect(m_maintenanceTimer, SIGNAL(timeout()), this, SLOT(performMaintenance()));
+}
+
+HistoryWriter::~HistoryWriter()
+{
+	clearStatements();
+}
+
+void HistoryWriter::setDatabase(const QString &path, const QString &journalMode)
+{
+	QMutexLocker locker(&m_mutex);
+
+	m_path = path;
+	m_journalMode = journalMode;
+}
+
+void HistoryWriter::addRecord(const HistoryRecord &record)
+{
+	QMutexLocker locker(&m_mutex);
+
+	if (m_records.contains(record.identifier))
+	{
+		HistoryRecord &pendingRecord = m_records[record.identifier];
+		pendingRecord.url = record.url;
+		pendingRecord.title = record.title;
+		pendingRecord.icon = record.icon;
+	}
+	else
+	{
+		m_order.append(record.identifier);
+		m_records[record.identifier] = record;
+	}
+
+	if (!m_isScheduled)
+	{
+		m_isScheduled = true;
+
+		QMetaObject::invokeMethod(this, "scheduleWrite", Qt::QueuedConnection);
+	}
+}
+
+QList<qint64> HistoryWriter::removeRecords(const QList<qint64> &entries)
+{
+	QMutexLocker locker(&m_mutex);
+	QList<qint64> discardedEntries;
+
+	for (int i = 0; i < entries.count(); ++i)
+	{
+		const qint64 entry = entries.at(i);
+		const bool isNew = (m_records.contains(entry) && m_records[entry].isNew);
+
+		m_order.removeAll(entry);
+		m_records.remove(entry);
+
+		if (isNew)
+		{
+			discardedEntries.append(entry);
+		}
+		else
+		{
+			m_removals.append(entry);
+		}
+	}
+
+	if (!m_removals.isEmpty())
+	{
+		QMetaObject::invokeMethod(this, "writeRecords", Qt::QueuedConnection);
+	}
+
+	return discardedEntries;
+}
+
+void HistoryWriter::clearRecords(int period)
+{
+	m_mutex.lock();
+
+	if (period > 0)
+	{
+		const uint time = (QDateTime::currentDateTime().toTime_t() - (period * 3600));
+
+		for (int i = (m_order.count() - 1); i >= 0; --i)
+		{
+			const qint64 entry = m_order.at(i);
+
+			if (m_records[entry].isNew && m_records[entry].time >= time)
+			{
+				m_order.removeAt(i);
+				m_records.remove(entry);
+			}
+		}
+	}
+	else
+	{
+		m_order.clear();
+		m_records.clear();
+		m_removals.clear();
+	}
+
+	m_mutex.unlock();
+
+	QMetaObject::invokeMethod(this, "clearDatabase", Qt::QueuedConnection, Q_ARG(int, period));
+}
+
+void HistoryWriter::flush()
+{
+	if (QThread::currentThread() == thread())
+	{
+		writeRecords();
+	}
+	else
+	{
+		QMetaObject::invokeMethod(this, "writeRecords", Qt::BlockingQueuedConnection);
+	}
+}
+
+void HistoryWriter::scheduleMaintenance(int amount, int period)
+{
+	m_mutex.lock();
+
+	m_limitAmount = amount;
+	m_limitPeriod = period;
+
+	m_mutex.unlock();
+
+	QMetaObject::invokeMethod(this, "startMaintenance", Qt::QueuedConnection, Q_ARG(int, 10000));
+}
+
+void HistoryWriter::startMaintenance(int delay)
+{
+	m_maintenanceTimer->start(delay);
+}
+
+void HistoryWriter::performMaintenance()
+{
+	m_mutex.lock();
+
+	const bool isBusy = !m_records.isEmpty();
+
+	m_mutex.unlock();
+
+	if (isBusy || m_timer->isActive())
+	{
+		startMaintenance(10000);
+
+		return;
+	}
+
+	if (!openDatabase())
+	{
+		return;
+	}
+
+	if (!removeExpiredRecords())
+	{
+		return;
+	}
+
+	QSqlDatabase database = QSqlDatabase::database(QLatin1String("browsingHistoryWriter"));
+	QSqlQuery query(database);
+
+	if (!query.exec(QLatin1String("PRAGMA auto_vacuum;")))
+	{
+		emit maintenanceFailed(query.lastError().text());
+
+		return;
+	}
+
+	const int mode = (query.next() ? query.value(0).toInt() : 0);
+
+	query.finish();
+
+	if (mode != 2)
+	{
+		return;
+	}
+
+	const QSqlError error = database.exec(QLatin1String("PRAGMA incremental_vacuum(256);")).lastError();
+
+	if (error.isValid())
+	{
+		emit maintenanceFailed(error.text());
+
+		return;
+	}
+
+	if (!query.exec(QLatin1String("PRAGMA freelist_count;")))
+	{
+		emit maintenanceFailed(query.lastError().text());
+
+		return;
+	}
+
+	const int freePages = (query.next() ? query.value(0).toInt() : 0);
+
+	query.finish();
+
+	if (freePages > 0)
+	{
+		startMaintenance(500);
+	}
+}
+
+void HistoryWriter::clearDatabase(int period)
+{
+	writeRecords();
+
+	if (openDatabase())
+	{
+		QSqlDatabase database = QSqlDatabase::database(QLatin1String("browsingHistoryWriter"));
+
+		if (period > 0)
+		{
+			database.exec(QStringLiteral("DELETE FROM \"visits\" WHERE \"time\" >= %1;").arg(QDateTime::currentDateTime().toTime_t() - (period * 3600)));
+		}
+		else
+		{
+			database.exec(QLatin1String("DELETE FROM \"visits\";"));
+			database.exec(QLatin1String("DELETE FROM \"locations\";"));
+			database.exec(QLatin1String("DELETE FROM \"hosts\";"));
+			database.exec(QLatin1String("DELETE FROM \"icons\";"));
+
+			clearStatements();
+
+			database.exec(QLatin1String("PRAGMA auto_vacuum = INCREMENTAL;"));
+			database.exec(QLatin1String("VACUUM;"));
+		}
+
+		m_icons.clear();
+	}
+
+	emit recordsCleared(period);
+}
+
+bool HistoryWriter::removeExpiredRecords()
+{
+	m_mutex.lock();
+
+	const int amount = m_limitAmount;
+	const int period = m_limitPeriod;
+
+	m_mutex.unlock();
+
+	QSqlDatabase database = QSqlDatabase::database(QLatin1String("browsingHistoryWriter"));
+	QSqlQuery query(database);
+	uint limit = ((period > 0) ? (QDateTime::currentDateTime().toTime_t() - (period * 86400)) : 0);
+
+	if (amount > 0)
+	{
+		query.prepare(QLatin1String("SELECT \"time\" FROM \"visits\" ORDER BY \"time\" DESC LIMIT 1 OFFSET ?;"));
+		query.bindValue(0, amount);
+
+		if (!query.exec())
+		{
+			emit maintenanceFailed(query.lastError().text());
+
+			return false;
+		}
+
+		if (query.next())
+		{
+			limit = qMax(limit, query.value(0).toUInt());
+		}
+
+		query.finish();
+	}
+
+	if (limit == 0)
+	{
+		return true;
+	}
+
+	database.transaction();
+
+	QList<qint64> removedRecords;
+	QList<QUrl> removedUrls;
+	QList<quint64> removedLocations;
+
+	query.prepare(QLatin1String("SELECT \"visits\".\"id\", \"locations\".\"scheme\", \"locations\".\"path\", \"hosts\".\"host\" FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" WHERE \"visits\".\"time\" <= ?;"));
+	query.bindValue(0, limit);
+	query.exec();
+
+	while (query.next())
+	{
+		const QString scheme = query.value(1).toString();
+		const QString path = query.value(2).toString();
+		const QString host = query.value(3).toString();
+
+		removedRecords.append(query.value(0).toLongLong());
+		removedUrls.append(HistoryManager::getLocationUrl(scheme, host, path));
+		removedLocations.append(HistoryManager::getLocationKey(scheme, host, path));
+	}
+
+	query.finish();
+
+	if (removedRecords.isEmpty())
+	{
+		database.rollback();
+
+		return true;
+	}
+
+	query.prepare(QLatin1String("DELETE FROM \"visits\" WHERE \"time\" <= ?;"));
+	query.bindValue(0, limit);
+
+	if (!query.exec() || !database.commit())
+	{
+		const QString error = (query.lastError().isValid() ? query.lastError().text() : database.lastError().text());
+
+		database.rollback();
+
+		emit maintenanceFailed(error);
+
+		return false;
+	}
+
+	query.finish();
+
+	m_icons.clear();
+
+	for (int i = 0; i < removedRecords.count(); ++i)
+	{
+		emit recordRemoved(removedRecords.at(i), removedUrls.at(i), removedLocations.at(i));
+	}
+
+	return true;
+}
+
+bool HistoryWriter::hasNewRecord(qint64 entry)
+{
+	QMutexLocker locker(&m_mutex);
+
+	return m_records.value(entry).isNew;
+}
+
+void HistoryWriter::scheduleWrite()
+{
+	if (!m_timer->isActive())
+	{
+		m_timer->start();
+	}
+}
+
+void HistoryWriter::writeRecords()
+{
+	m_timer->stop();
+
+	m_mutex.lock();
+
+	const QList<qint64> order = m_order;
+	const QList<qint64> removals = m_removals;
+	const QHash<qint64, HistoryRecord> records = m_records;
+
+	m_order.clear();
+	m_removals.clear();
+	m_records.clear();
+
+	m_isScheduled = false;
+
+	m_mutex.unlock();
+
+	if ((order.isEmpty() && removals.isEmpty()) || !openDatabase())
+	{
+		return;
+	}
+
+	m_icons.clear();
+
+	QSqlDatabase database = QSqlDatabase::database(QLatin1String("browsingHistoryWriter"));
+	database.transaction();
+
+	QSqlQuery &insertQuery = *getStatement(InsertVisitStatement);
+	QSqlQuery &updateQuery = *getStatement(UpdateVisitStatement);
+	QSqlQuery &locationQuery = *getStatement(VisitLocationStatement);
+	QList<qint64> writtenRecords;
+	QList<quint64> replacedLocations;
+
+	for (int i = 0; i < order.count(); ++i)
+	{
+		const HistoryRecord record = records.value(order.at(i));
+		const qint64 location = getLocation(record.url);
+		const qint64 icon = getIcon(record.icon);
+
+		if (record.isNew)
+		{
+			insertQuery.bindValue(0, record.identifier);
+			insertQuery.bindValue(1, location);
+			insertQuery.bindValue(2, icon);
+			insertQuery.bindValue(3, record.title);
+			insertQuery.bindValue(4, record.time);
+			insertQuery.bindValue(5, record.typed);
+
+			if (insertQuery.exec())
+			{
+				writtenRecords.append(record.identifier);
+			}
+		}
+		else
+		{
+			if (record.reportLocation)
+			{
+				locationQuery.bindValue(0, record.identifier);
+
+				if (locationQuery.exec() && locationQuery.next())
+				{
+					replacedLocations.append(HistoryManager::getLocationKey(locationQuery.value(0).toString(), locationQuery.value(2).toString(), locationQuery.value(1).toString()));
+				}
+
+				locationQuery.finish();
+			}
+
+			updateQuery.bindValue(0, location);
+			updateQuery.bindValue(1, icon);
+			updateQuery.bindValue(2, record.title);
+			updateQuery.bindValue(3, record.identifier);
+
+			if (updateQuery.exec() && updateQuery.numRowsAffected() > 0)
+			{
+				writtenRecords.append(record.identifier);
+
+				m_icons.clear();
+			}
+		}
+	}
+
+	QList<qint64> removedRecords;
+	QList<QUrl> removedUrls;
+	QList<quint64> removedLocations;
+
+	if (!removals.isEmpty())
+	{
+		QSqlQuery &removeQuery = *getStatement(RemoveVisitStatement);
+
+		for (int i = 0; i < removals.count(); ++i)
+		{
+			locationQuery.bindValue(0, removals.at(i));
+
+			if (!locationQuery.exec() || !locationQuery.next())
+			{
+				locationQuery.finish();
+
+				continue;
+			}
+
+			const QString scheme = locationQuery.value(0).toString();
+			const QString path = locationQuery.value(1).toString();
+			const QString host = locationQuery.value(2).toString();
+
+			locationQuery.finish();
+
+			removeQuery.bindValue(0, removals.at(i));
+
+			if (removeQuery.exec() && removeQuery.numRowsAffected() > 0)
+			{
+				removedRecords.append(removals.at(i));
+				removedUrls.append(HistoryManager::getLocationUrl(scheme, host, path));
+				removedLocations.append(HistoryManager::getLocationKey(scheme, host, path));
+			}
+		}
+	}
+
+	database.commit();
+
+	for (int i = 0; i < replacedLocations.count(); ++i)
+	{
+		emit locationReplaced(replacedLocations.at(i));
+	}
+
+	for (int i = 0; i < writtenRecords.count(); ++i)
+	{
+		emit recordWritten(writtenRecords.at(i), records.value(writtenRecords.at(i)).isNew);
+	}
+
+	for (int i = 0; i < removedRecords.count(); ++i)
+	{
+		emit recordRemoved(removedRecords.at(i), removedUrls.at(i), removedLocations.at(i));
+	}
+}
+
+bool HistoryWriter::openDatabase()
+{
+	m_mutex.lock();
+
+	const QString path = m_path;
+	const QString journalMode = m_journalMode;
+
+	m_mutex.unlock();
+
+	if (path == m_openedPath)
+	{
+		return !path.isEmpty();
+	}
+
+	clearStatements();
+
+	if (!m_openedPath.isEmpty())
+	{
+		QSqlDatabase::database(QLatin1String("browsingHistoryWriter")).close();
+		QSqlDatabase::removeDatabase(QLatin1String("browsingHistoryWriter"));
+	}
+
+	m_openedPath = path;
+
+	if (path.isEmpty())
+	{
+		return false;
+	}
+
+	QSqlDatabase database = QSqlDatabase::addDatabase(QLatin1String("QSQLITE"), QLatin1String("browsingHistoryWriter"));
+	database.setDatabaseName(path);
+	database.setConnectOptions(QLatin1String("QSQLITE_BUSY_TIMEOUT=5000"));
+	database.open();
+	database.exec(QStringLiteral("PRAGMA journal_mode = %1;").arg(journalMode));
+
+	return database.isOpen();
+}
+
+void HistoryWriter::clearStatements()
+{
+	qDeleteAll(m_statements);
+
+	m_statements.clear();
+}
+
+QSqlQuery* HistoryWriter::getStatement(StatementType type)
+{
+	if (m_statements.contains(type))
+	{
+		return m_statements[type];
+	}
+
+	QSqlQuery *query = new QSqlQuery(QSqlDatabase::database(QLatin1String("browsingHistoryWriter")));
+
+	switch (type)
+	{
+		case InsertVisitStatement:
+			query->prepare(QLatin1String("INSERT INTO \"visits\" (\"id\", \"location\", \"icon\", \"title\", \"time\", \"typed\") VALUES(?, ?, ?, ?, ?, ?);"));
+
+			break;
+		case UpdateVisitStatement:
+			query->prepare(QLatin1String("UPDATE \"visits\" SET \"location\" = ?, \"icon\" = ?, \"title\" = ? WHERE \"id\" = ?;"));
+
+			break;
+		case RemoveVisitStatement:
+			query->prepare(QLatin1String("DELETE FROM \"visits\" WHERE \"id\" = ?;"));
+
+			break;
+		case VisitLocationStatement:
+			query->prepare(QLatin1String("SELECT \"locations\".\"scheme\", \"locations\".\"path\", \"hosts\".\"host\" FROM \"visits\" LEFT JOIN \"locations\" ON \"visits\".\"location\" = \"locations\".\"id\" LEFT JOIN \"hosts\" ON \"locations\".\"host\" = \"hosts\".\"id\" WHERE \"visits\".\"id\" = ?;"));
+
+			break;
+		case SelectHostStatement:
+			query->prepare(QLatin1String("SELECT \"id\" FROM \"hosts\" WHERE \"host\" = ?;"));
+
+			break;
+		case InsertHostStatement:
+			query->prepare(QLatin1String("INSERT INTO \"hosts\" (\"host\") VALUES(?);"));
+
+			break;
+		case SelectLocationStatement:
+			query->prepare(QLatin1String("SELECT \"id\" FROM \"locations\" WHERE \"host\" = ? AND \"scheme\" = ? AND \"path\" = ?;"));
+
+			break;
+		case InsertLocationStatement:
+			query->prepare(QLatin1String("INSERT INTO \"locations\" (\"host\", \"scheme\", \"path\") VALUES(?, ?, ?);"));
+
+			break;
+		case SelectIconStatement:
+			query->prepare(QLatin1String("SELECT \"id\" FROM \"icons\" WHERE \"hash\" = ?;"));
+
+			break;
+		case InsertIconStatement:
+			query->prepare(QLatin1String("INSERT INTO \"icons\" (\"hash\", \"icon\") VALUES(?, ?);"));
+
+			break;
+		default:
+			break;
+	}
+
+	m_statements[type] = query;
+
+	return query;
+}
+
+qint64 HistoryWriter::getHost(const QString &host)
+{
+	QSqlQuery *selectQuery = getStatement(SelectHostStatement);
+	selectQuery->bindValue(0, host);
+	selectQuery->exec();
+
+	if (selectQuery->next())
+	{
+		const qint64 identifier = selectQuery->value(0).toLongLong();
+
+		selectQuery->finish();
+
+		return identifier;
+	}
+
+	QSqlQuery *insertQuery = getStatement(InsertHostStatement);
+	insertQuery->bindValue(0, host);
+	insertQuery->exec();
+
+	return insertQuery->lastInsertId().toLongLong();
+}
+
+qint64 HistoryWriter::getLocation(const QUrl &url)
+{
+	const qint64 host = getHost(url.host());
+	const QString scheme = url.scheme();
+	const QString path = HistoryManager::getLocationPath(url);
+	QSqlQuery *selectQuery = getStatement(SelectLocationStatement);
+	selectQuery->bindValue(0, host);
+	selectQuery->bindValue(1, scheme);
+	selectQuery->bindValue(2, path);
+	selectQuery->exec();
+
+	if (selectQuery->next())
+	{
+		const qint64 identifier = selectQuery->value(0).toLongLong();
+
+		selectQuery->finish();
+
+		return identifier;
+	}
+
+	QSqlQuery *insertQuery = getStatement(InsertLocationStatement);
+	insertQuery->bindValue(0, host);
+	insertQuery->bindValue(1, scheme);
+	insertQuery->bindValue(2, path);
+	insertQuery->exec();
+
+	return insertQuery->lastInsertId().toLongLong();
+}
+
+qint64 HistoryWriter::getIcon(const QImage &icon)
+{
+	if (icon.isNull())
+	{
+		return 0;
+	}
+
+	const qint64 hash = HistoryManager::getIconHash(icon);
+
+	if (m_icons.contains(hash))
+	{
+		return m_icons.value(hash);
+	}
+
+	QSqlQuery *selectQuery = getStatement(SelectIconStatement);
+	selectQuery->bindValue(0, hash);
+	selectQuery->exec();
+
+	if (selectQuery->next())
+	{
+		m_icons[hash] = selectQuery->value(0).toLongLong();
+
+		selectQuery->finish();
+
+		return m_icons[hash];
+	}
+
+	QByteArray data;
+	QBuffer buffer(&data);
+	buffer.open(QIODevice::WriteOnly);
+
+	icon.save(&buffer, "PNG");
+
+	QSqlQuery *insertQuery = getStatement(InsertIconStatement);
+	insertQuery->bindValue(0, hash);
+	insertQuery->bindValue(1, data);
+	insertQuery->exec();
+
+	m_icons[hash] = insertQuery->lastInsertId().toLongLong();
+
+	return m_icons[hash];
+}
+
+}
@@ -0,0 +1,120 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2013 - 2014 Michal Dutkiewicz aka Emdek <michal@emdek.pl>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#ifndef OTTER_HISTORYWRITER_H
+#define OTTER_HISTORYWRITER_H
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QTimer>
+#include <QtCore/QUrl>
+#include <QtGui/QImage>
+#include <QtSql/QSqlQuery>
+
+namespace Otter
+{
+
+struct HistoryRecord
+{
+	QUrl url;
+	QString title;
+	QImage icon;
+	qint64 identifier;
+	uint time;
+	bool typed;
+	bool isNew;
+	bool reportLocation;
+
+	HistoryRecord() : identifier(-1), time(0), typed(false), isNew(false), reportLocation(false) {}
+};
+
+class HistoryWriter : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit HistoryWriter(QObject *parent = NULL);
+	~HistoryWriter();
+
+	void setDatabase(const QString &path, const QString &journalMode);
+	void addRecord(const HistoryRecord &record);
+	QList<qint64> removeRecords(const QList<qint64> &entries);
+	void clearRecords(int period);
+	void scheduleMaintenance(int amount, int period);
+	void flush();
+	bool hasNewRecord(qint64 entry);
+
+protected:
+	enum StatementType
+	{
+		InsertVisitStatement = 0,
+		UpdateVisitStatement = 1,
+		RemoveVisitStatement = 2,
+		VisitLocationStatement = 3,
+		SelectHostStatement = 4,
+		InsertHostStatement = 5,
+		SelectLocationStatement = 6,
+		InsertLocationStatement = 7,
+		SelectIconStatement = 8,
+		InsertIconStatement = 9
+	};
+
+	void clearStatements();
+	QSqlQuery* getStatement(StatementType type);
+	bool openDatabase();
+	bool removeExpiredRecords();
+	qint64 getHost(const QString &host);
+	qint64 getLocation(const QUrl &url);
+	qint64 getIcon(const QImage &icon);
+
+protected slots:
+	void scheduleWrite();
+	void writeRecords();
+	void clearDatabase(int period);
+	void startMaintenance(int delay);
+	void performMaintenance();
+
+private:
+	QTimer *m_timer;
+	QTimer *m_maintenanceTimer;
+	QString m_path;
+	QString m_openedPath;
+	QString m_journalMode;
+	QList<qint64> m_order;
+	QList<qint64> m_removals;
+	QHash<qint64, HistoryRecord> m_records;
+	QHash<qint64, qint64> m_icons;
+	QHash<int, QSqlQuery*> m_statements;
+	QMutex m_mutex;
+	int m_limitAmount;
+	int m_limitPeriod;
+	bool m_isScheduled;
+
+signals:
+	void recordWritten(qint64 entry, bool isNew);
+	void recordRemoved(qint64 entry, const QUrl &url, quint64 location);
+	void locationReplaced(quint64 location);
+	void recordsCleared(int period);
+	void maintenanceFailed(const QString &error);
+};
+
+}
+
+#endif
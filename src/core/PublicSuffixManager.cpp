@@ -0,0 +1,240 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2014 Jan Bajer aka bajasoft <jbajer@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#include "PublicSuffixManager.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QTextStream>
+#include <QtCore/QtAlgorithms>
+#include <QtCore/QUrl>
+
+namespace Otter
+{
+
+PublicSuffixManager* PublicSuffixManager::m_instance = NULL;
+QVector<PublicSuffixManager::Rule> PublicSuffixManager::m_rules;
+
+PublicSuffixManager::PublicSuffixManager(QObject *parent) : QObject(parent)
+{
+	QFile file(QLatin1String(":/other/publicSuffixList.dat"));
+	file.open(QIODevice::ReadOnly | QIODevice::Text);
+
+	QTextStream stream(&file);
+	stream.setCodec("UTF-8");
+
+	while (!stream.atEnd())
+	{
+		QString line = stream.readLine().trimmed();
+
+		if (line.isEmpty() || line.startsWith(QLatin1String("//")))
+		{
+			continue;
+		}
+
+		const int whitespace = line.indexOf(QLatin1Char(' '));
+
+		if (whitespace > 0)
+		{
+			line = line.left(whitespace);
+		}
+
+		RuleType type = NormalRule;
+
+		if (line.startsWith(QLatin1Char('!')))
+		{
+			line = line.mid(1);
+			type = ExceptionRule;
+		}
+		else if (line.startsWith(QLatin1String("*.")))
+		{
+			line = line.mid(2);
+			type = WildcardRule;
+		}
+
+		line = line.toLower();
+
+		addRule(line, type);
+
+		const QString asciiLine = QString::fromLatin1(QUrl::toAce(line));
+
+		if (!asciiLine.isEmpty() && asciiLine != line)
+		{
+			addRule(asciiLine, type);
+		}
+	}
+
+	qSort(m_rules);
+
+	QVector<Rule> rules;
+	rules.reserve(m_rules.count());
+
+	for (int i = 0; i < m_rules.count(); ++i)
+	{
+		if (!rules.isEmpty() && rules.last().hash == m_rules.at(i).hash)
+		{
+			rules.last().types |= m_rules.at(i).types;
+		}
+		else
+		{
+			rules.append(m_rules.at(i));
+		}
+	}
+
+	m_rules = rules;
+}
+
+void PublicSuffixManager::createInstance(QObject *parent)
+{
+	if (!m_instance)
+	{
+		m_instance = new PublicSuffixManager(parent);
+	}
+}
+
+void PublicSuffixManager::addRule(const QString &suffix, RuleType type)
+{
+	Rule rule;
+	rule.hash = getHash(suffix, 0);
+	rule.types = type;
+
+	m_rules.append(rule);
+}
+
+PublicSuffixManager* PublicSuffixManager::getInstance()
+{
+	return m_instance;
+}
+
+QString PublicSuffixManager::getRegistrableDomain(const QString &host)
+{
+	const int position = getRegistrableDomainStart(host);
+
+	return ((position < 0) ? QString() : host.mid(position));
+}
+
+quint64 PublicSuffixManager::getHash(const QString &host, int position)
+{
+	quint64 hash = Q_UINT64_C(14695981039346656037);
+
+	for (int i = position; i < host.length(); ++i)
+	{
+		ushort value = host.at(i).unicode();
+
+		if (value >= 'A' && value <= 'Z')
+		{
+			value += ('a' - 'A');
+		}
+
+		hash = ((hash ^ value) * Q_UINT64_C(1099511628211));
+	}
+
+	return hash;
+}
+
+quint32 PublicSuffixManager::getRuleTypes(const QString &host, int position)
+{
+	const quint64 hash = getHash(host, position);
+	int first = 0;
+	int last = (m_rules.count() - 1);
+
+	while (first <= last)
+	{
+		const int middle = ((first + last) / 2);
+
+		if (m_rules.at(middle).hash == hash)
+		{
+			return m_rules.at(middle).types;
+		}
+
+		if (m_rules.at(middle).hash < hash)
+		{
+			first = (middle + 1);
+		}
+		else
+		{
+			last = (middle - 1);
+		}
+	}
+
+	return NoRule;
+}
+
+int PublicSuffixManager::getRegistrableDomainStart(const QString &host)
+{
+	if (host.isEmpty() || host.endsWith(QLatin1Char('.')))
+	{
+		return -1;
+	}
+
+	if (host.contains(QLatin1Char(':')) || host.at(host.length() - 1).isDigit())
+	{
+		return 0;
+	}
+
+	int suffixStart = (host.lastIndexOf(QLatin1Char('.')) + 1);
+	int parentStart = -1;
+	quint32 parentTypes = NoRule;
+
+	for (int position = host.length() - 1; position >= 0; --position)
+	{
+		if (position > 0 && host.at(position - 1) != QLatin1Char('.'))
+		{
+			continue;
+		}
+
+		const quint32 types = getRuleTypes(host, position);
+
+		if (types & ExceptionRule)
+		{
+			suffixStart = parentStart;
+
+			break;
+		}
+
+		if ((types & NormalRule) || (parentTypes & WildcardRule))
+		{
+			suffixStart = position;
+		}
+
+		parentStart = position;
+		parentTypes = types;
+	}
+
+	if (suffixStart <= 0)
+	{
+		return -1;
+	}
+
+	return (host.lastIndexOf(QLatin1Char('.'), (suffixStart - 2)) + 1);
+}
+
+bool PublicSuffixManager::isThirdParty(const QString &host, const QString &baseHost)
+{
+	if (baseHost.isEmpty() || host == baseHost)
+	{
+		return false;
+	}
+
+	const int position = qMax(0, getRegistrableDomainStart(host));
+	const int basePosition = qMax(0, getRegistrableDomainStart(baseHost));
+
+	return (host.midRef(position).compare(baseHost.midRef(basePosition), Qt::CaseInsensitive) != 0);
+}
+
+}
@@ -0,0 +1,73 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2014 Jan Bajer aka bajasoft <jbajer@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#ifndef OTTER_PUBLICSUFFIXMANAGER_H
+#define OTTER_PUBLICSUFFIXMANAGER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QVector>
+
+namespace Otter
+{
+
+class PublicSuffixManager : public QObject
+{
+	Q_OBJECT
+
+public:
+	static void createInstance(QObject *parent = NULL);
+	static PublicSuffixManager* getInstance();
+	static QString getRegistrableDomain(const QString &host);
+	static int getRegistrableDomainStart(const QString &host);
+	static bool isThirdParty(const QString &host, const QString &baseHost);
+
+protected:
+	enum RuleType
+	{
+		NoRule = 0,
+		NormalRule = 1,
+		WildcardRule = 2,
+		ExceptionRule = 4
+	};
+
+	struct Rule
+	{
+		quint64 hash;
+		quint32 types;
+
+		bool operator<(const Rule &other) const
+		{
+			return (hash < other.hash);
+		}
+	};
+
+	explicit PublicSuffixManager(QObject *parent = NULL);
+
+	static void addRule(const QString &suffix, RuleType type);
+	static quint32 getRuleTypes(const QString &host, int position);
+	static quint64 getHash(const QString &host, int position);
+
+private:
+	static PublicSuffixManager *m_instance;
+	static QVector<Rule> m_rules;
+};
+
+}
+
+#endif
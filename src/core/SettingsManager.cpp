@@ -20,8 +20,11 @@
 
 #include "SettingsManager.h"
 
+#include <QtConcurrent/QtConcurrentRun>
 #include <QtCore/QFileInfo>
+#include <QtCore/QSet>
 #include <QtCore/QSettings>
+#include <QtCore/QTimerEvent>
 
 namespace Otter
 {
@@ -30,9 +33,47 @@ SettingsManager* SettingsManager::m_instance = NULL;
 QString SettingsManager::m_globalPath;
 QString SettingsManager::m_overridePath;
 QHash<QString, QVariant> SettingsManager::m_defaults;
+QHash<QString, QVariant> SettingsManager::m_globalValues;
+QHash<QString, QHash<QString, QVariant> > SettingsManager::m_overrideValues;
+QHash<QString, QVariantHash> SettingsManager::m_hostOptions;
+QSet<QString> SettingsManager::m_modifiedGlobalKeys;
+QSet<QString> SettingsManager::m_modifiedOverrideHosts;
 
-SettingsManager::SettingsManager(QObject *parent) : QObject(parent)
+SettingsManager::SettingsManager(QObject *parent) : QObject(parent),
+	m_fileSystemWatcher(new QFileSystemWatcher(this)),
+	m_saveTimer(0),
+	m_isGlobalChanged(false),
+	m_isOverrideChanged(false)
 {
+	connect(m_fileSystemWatcher, SIGNAL(fileChanged(QString)), this, SLOT(fileChanged(QString)));
+	connect(&m_saveWatcher, SIGNAL(finished()), this, SLOT(saveFinished()));
+}
+
+SettingsManager::~SettingsManager()
+{
+	m_saveWatcher.waitForFinished();
+
+	if (!m_modifiedGlobalKeys.isEmpty() || !m_modifiedOverrideHosts.isEmpty())
+	{
+		writeValues(m_globalPath, getModifiedGlobalValues(), m_overridePath, getModifiedOverrideValues());
+	}
+}
+
+void SettingsManager::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() != m_saveTimer || m_saveWatcher.isRunning())
+	{
+		return;
+	}
+
+	killTimer(m_saveTimer);
+
+	m_saveTimer = 0;
+
+	m_saveWatcher.setFuture(QtConcurrent::run(&SettingsManager::writeValues, m_globalPath, getModifiedGlobalValues(), m_overridePath, getModifiedOverrideValues()));
+
+	m_modifiedGlobalKeys.clear();
+	m_modifiedOverrideHosts.clear();
 }
 
 void SettingsManager::createInstance(const QString &path, QObject *parent)
@@ -42,31 +83,299 @@ void SettingsManager::createInstance(const QString &path, QObject *parent)
 		m_instance = new SettingsManager(parent);
 		m_globalPath = path + QLatin1String("/otter.conf");
 		m_overridePath = path + QLatin1String("/override.ini");
+
+		readGlobalValues(m_globalPath, m_globalValues);
+		readOverrideValues(m_overridePath, m_overrideValues);
+
+		m_instance->watchFiles();
+	}
+}
+
+void SettingsManager::scheduleSave(const QString &key, bool overrides)
+{
+	m_hostOptions.clear();
+
+	if (overrides)
+	{
+		m_modifiedOverrideHosts.insert(key);
+	}
+	else
+	{
+		m_modifiedGlobalKeys.insert(key);
+	}
+
+	if (m_saveTimer == 0)
+	{
+		m_saveTimer = startTimer(1000);
+	}
+}
+
+void SettingsManager::watchFiles()
+{
+	const QStringList paths = (QStringList() << m_globalPath << m_overridePath);
+	const QStringList watchedPaths = m_fileSystemWatcher->files();
+
+	for (int i = 0; i < paths.count(); ++i)
+	{
+		if (!watchedPaths.contains(paths.at(i)) && QFile::exists(paths.at(i)))
+		{
+			m_fileSystemWatcher->addPath(paths.at(i));
+		}
+	}
+}
+
+void SettingsManager::fileChanged(const QString &path)
+{
+	watchFiles();
+
+	if (m_saveWatcher.isRunning())
+	{
+		if (path == m_globalPath)
+		{
+			m_isGlobalChanged = true;
+		}
+		else if (path == m_overridePath)
+		{
+			m_isOverrideChanged = true;
+		}
+
+		return;
+	}
+
+	if (path == m_globalPath)
+	{
+		QHash<QString, QVariant> values;
+
+		readGlobalValues(path, values);
+
+		QSet<QString>::const_iterator iterator;
+
+		for (iterator = m_modifiedGlobalKeys.constBegin(); iterator != m_modifiedGlobalKeys.constEnd(); ++iterator)
+		{
+			if (m_globalValues.contains(*iterator))
+			{
+				values[*iterator] = m_globalValues.value(*iterator);
+			}
+			else
+			{
+				values.remove(*iterator);
+			}
+		}
+
+		if (values == m_globalValues)
+		{
+			return;
+		}
+
+		const QHash<QString, QVariant> previousValues = m_globalValues;
+		const QStringList keys = (previousValues.keys() + values.keys()).toSet().toList();
+
+		m_globalValues = values;
+		m_hostOptions.clear();
+
+		for (int i = 0; i < keys.count(); ++i)
+		{
+			const QVariant value = getValue(keys.at(i));
+
+			if (previousValues.value(keys.at(i), getDefaultValue(keys.at(i))) != value)
+			{
+				emit valueChanged(keys.at(i), value);
+			}
+		}
+	}
+	else if (path == m_overridePath)
+	{
+		QHash<QString, QHash<QString, QVariant> > values;
+
+		readOverrideValues(path, values);
+
+		QSet<QString>::const_iterator iterator;
+
+		for (iterator = m_modifiedOverrideHosts.constBegin(); iterator != m_modifiedOverrideHosts.constEnd(); ++iterator)
+		{
+			if (m_overrideValues.contains(*iterator))
+			{
+				values[*iterator] = m_overrideValues.value(*iterator);
+			}
+			else
+			{
+				values.remove(*iterator);
+			}
+		}
+
+		m_overrideValues = values;
+		m_hostOptions.clear();
+	}
+}
+
+void SettingsManager::saveFinished()
+{
+	watchFiles();
+
+	if (m_isGlobalChanged)
+	{
+		m_isGlobalChanged = false;
+
+		fileChanged(m_globalPath);
+	}
+
+	if (m_isOverrideChanged)
+	{
+		m_isOverrideChanged = false;
+
+		fileChanged(m_overridePath);
+	}
+}
+
+void SettingsManager::readGlobalValues(const QString &path, QHash<QString, QVariant> &values)
+{
+	const QSettings settings(path, QSettings::IniFormat);
+	const QStringList keys = settings.allKeys();
+
+	values.clear();
+	values.reserve(keys.count());
+
+	for (int i = 0; i < keys.count(); ++i)
+	{
+		values[keys.at(i)] = settings.value(keys.at(i));
 	}
 }
 
+void SettingsManager::readOverrideValues(const QString &path, QHash<QString, QHash<QString, QVariant> > &values)
+{
+	QSettings settings(path, QSettings::IniFormat);
+	const QStringList hosts = settings.childGroups();
+
+	values.clear();
+	values.reserve(hosts.count());
+
+	for (int i = 0; i < hosts.count(); ++i)
+	{
+		settings.beginGroup(hosts.at(i));
+
+		const QStringList keys = settings.allKeys();
+		QHash<QString, QVariant> hostValues;
+
+		for (int j = 0; j < keys.count(); ++j)
+		{
+			hostValues[keys.at(j)] = settings.value(keys.at(j));
+		}
+
+		values[hosts.at(i)] = hostValues;
+
+		settings.endGroup();
+	}
+}
+
+void SettingsManager::writeValues(const QString &globalPath, const QHash<QString, QVariant> &globalValues, const QString &overridePath, const QHash<QString, QHash<QString, QVariant> > &overrideValues)
+{
+	if (!globalValues.isEmpty())
+	{
+		QSettings settings(globalPath, QSettings::IniFormat);
+		QHash<QString, QVariant>::const_iterator iterator;
+
+		for (iterator = globalValues.constBegin(); iterator != globalValues.constEnd(); ++iterator)
+		{
+			if (iterator.value().isValid())
+			{
+				settings.setValue(iterator.key(), iterator.value());
+			}
+			else
+			{
+				settings.remove(iterator.key());
+			}
+		}
+
+		settings.sync();
+	}
+
+	if (!overrideValues.isEmpty())
+	{
+		QSettings settings(overridePath, QSettings::IniFormat);
+		QHash<QString, QHash<QString, QVariant> >::const_iterator hostsIterator;
+
+		for (hostsIterator = overrideValues.constBegin(); hostsIterator != overrideValues.constEnd(); ++hostsIterator)
+		{
+			settings.remove(hostsIterator.key());
+			settings.beginGroup(hostsIterator.key());
+
+			QHash<QString, QVariant>::const_iterator iterator;
+
+			for (iterator = hostsIterator.value().constBegin(); iterator != hostsIterator.value().constEnd(); ++iterator)
+			{
+				settings.setValue(iterator.key(), iterator.value());
+			}
+
+			settings.endGroup();
+		}
+
+		settings.sync();
+	}
+}
+
+QHash<QString, QVariant> SettingsManager::getModifiedGlobalValues()
+{
+	QHash<QString, QVariant> values;
+	QSet<QString>::const_iterator iterator;
+
+	for (iterator = m_modifiedGlobalKeys.constBegin(); iterator != m_modifiedGlobalKeys.constEnd(); ++iterator)
+	{
+		values[*iterator] = m_globalValues.value(*iterator);
+	}
+
+	return values;
+}
+
+QHash<QString, QHash<QString, QVariant> > SettingsManager::getModifiedOverrideValues()
+{
+	QHash<QString, QHash<QString, QVariant> > values;
+	QSet<QString>::const_iterator iterator;
+
+	for (iterator = m_modifiedOverrideHosts.constBegin(); iterator != m_modifiedOverrideHosts.constEnd(); ++iterator)
+	{
+		values[*iterator] = m_overrideValues.value(*iterator);
+	}
+
+	return values;
+}
+
 void SettingsManager::registerOption(const QString &key)
 {
-	QSettings(m_globalPath, QSettings::IniFormat).remove(key);
+	if (m_globalValues.remove(key) > 0)
+	{
+		m_instance->scheduleSave(key, false);
+	}
+
+	m_hostOptions.clear();
 
 	emit m_instance->valueChanged(key, getValue(key));
 }
 
 void SettingsManager::removeOverride(const QUrl &url, const QString &key)
 {
+	const QString host = getHost(url);
+
 	if (key.isEmpty())
 	{
-		QSettings(m_overridePath, QSettings::IniFormat).remove(url.isLocalFile() ? QLatin1String("localhost") : url.host());
+		m_overrideValues.remove(host);
 	}
-	else
+	else if (m_overrideValues.contains(host))
 	{
-		QSettings(m_overridePath, QSettings::IniFormat).remove((url.isLocalFile() ? QLatin1String("localhost") : url.host()) + QLatin1Char('/') + key);
+		m_overrideValues[host].remove(key);
+
+		if (m_overrideValues[host].isEmpty())
+		{
+			m_overrideValues.remove(host);
+		}
 	}
+
+	m_instance->scheduleSave(host, true);
 }
 
 void SettingsManager::setDefaultValue(const QString &key, const QVariant &value)
 {
 	m_defaults[key] = value;
+	m_hostOptions.clear();
 
 	emit m_instance->valueChanged(key, getValue(key));
 }
@@ -77,11 +386,15 @@ void SettingsManager::setValue(const QString &key, const QVariant &value, const
 	{
 		if (value.isNull())
 		{
-			QSettings(m_overridePath, QSettings::IniFormat).remove((url.isLocalFile() ? QLatin1String("localhost") : url.host()) + QLatin1Char('/') + key);
+			removeOverride(url, key);
 		}
 		else
 		{
-			QSettings(m_overridePath, QSettings::IniFormat).setValue((url.isLocalFile() ? QLatin1String("localhost") : url.host()) + QLatin1Char('/') + key, value);
+			const QString host = getHost(url);
+
+			m_overrideValues[host][key] = value;
+
+			m_instance->scheduleSave(host, true);
 		}
 
 		return;
@@ -89,7 +402,9 @@ void SettingsManager::setValue(const QString &key, const QVariant &value, const
 
 	if (getValue(key) != value)
 	{
-		QSettings(m_globalPath, QSettings::IniFormat).setValue(key, value);
+		m_globalValues[key] = value;
+
+		m_instance->scheduleSave(key, false);
 
 		emit m_instance->valueChanged(key, value);
 	}
@@ -100,31 +415,92 @@ SettingsManager* SettingsManager::getInstance()
 	return m_instance;
 }
 
+QString SettingsManager::getHost(const QUrl &url)
+{
+	return (url.isLocalFile() ? QLatin1String("localhost") : url.host());
+}
+
 QVariant SettingsManager::getDefaultValue(const QString &key)
 {
-	return m_defaults[key];
+	return m_defaults.value(key);
 }
 
 QVariant SettingsManager::getValue(const QString &key, const QUrl &url)
 {
 	if (!url.isEmpty())
 	{
-		return QSettings(m_overridePath, QSettings::IniFormat).value((url.isLocalFile() ? QLatin1String("localhost") : url.host()) + QLatin1Char('/') + key, getValue(key));
+		return getOptions(url).value(key);
 	}
 
-	return QSettings(m_globalPath, QSettings::IniFormat).value(key, getDefaultValue(key));
+	return m_globalValues.value(key, getDefaultValue(key));
 }
 
-bool SettingsManager::hasOverride(const QUrl &url, const QString &key)
+QVariantHash SettingsManager::getOptions(const QUrl &url)
 {
-	if (key.isEmpty())
+	const QString host = getHost(url);
+	const QHash<QString, QVariantHash>::const_iterator cachedOptions = m_hostOptions.constFind(host);
+
+	if (cachedOptions != m_hostOptions.constEnd())
 	{
-		return QSettings(m_overridePath, QSettings::IniFormat).childGroups().contains(url.isLocalFile() ? QLatin1String("localhost") : url.host());
+		return cachedOptions.value();
 	}
-	else
+
+	QVariantHash options = m_defaults;
+	QHash<QString, QVariant>::const_iterator iterator;
+
+	for (iterator = m_globalValues.constBegin(); iterator != m_globalValues.constEnd(); ++iterator)
+	{
+		options[iterator.key()] = iterator.value();
+	}
+
+	if (!m_overrideValues.isEmpty() && !host.isEmpty())
 	{
-		return QSettings(m_overridePath, QSettings::IniFormat).contains((url.isLocalFile() ? QLatin1String("localhost") : url.host()) + QLatin1Char('/') + key);
+		const QStringList labels = host.split(QLatin1Char('.'));
+		QStringList patterns;
+
+		for (int i = (labels.count() - 1); i >= 0; --i)
+		{
+			patterns.append(QLatin1String("*.") + QStringList(labels.mid(i)).join(QLatin1Char('.')));
+		}
+
+		patterns.append(host);
+
+		for (int i = 0; i < patterns.count(); ++i)
+		{
+			const QHash<QString, QHash<QString, QVariant> >::const_iterator overrides = m_overrideValues.constFind(patterns.at(i));
+
+			if (overrides == m_overrideValues.constEnd())
+			{
+				continue;
+			}
+
+			for (iterator = overrides.value().constBegin(); iterator != overrides.value().constEnd(); ++iterator)
+			{
+				options[iterator.key()] = iterator.value();
+			}
+		}
 	}
+
+	if (m_hostOptions.count() > 100)
+	{
+		m_hostOptions.clear();
+	}
+
+	m_hostOptions[host] = options;
+
+	return options;
+}
+
+bool SettingsManager::hasOverride(const QUrl &url, const QString &key)
+{
+	const QHash<QString, QHash<QString, QVariant> >::const_iterator iterator = m_overrideValues.constFind(getHost(url));
+
+	if (iterator == m_overrideValues.constEnd())
+	{
+		return false;
+	}
+
+	return (key.isEmpty() || iterator.value().contains(key));
 }
 
 }
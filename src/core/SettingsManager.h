@@ -21,7 +21,10 @@
 #ifndef OTTER_SETTINGSMANAGER_H
 #define OTTER_SETTINGSMANAGER_H
 
+#include <QtCore/QFileSystemWatcher>
+#include <QtCore/QFutureWatcher>
 #include <QtCore/QObject>
+#include <QtCore/QSet>
 #include <QtCore/QUrl>
 #include <QtCore/QVariant>
 
@@ -33,6 +36,8 @@ class SettingsManager : public QObject
 	Q_OBJECT
 
 public:
+	~SettingsManager();
+
 	static void createInstance(const QString &path, QObject *parent = NULL);
 	static void registerOption(const QString &key);
 	static void removeOverride(const QUrl &url, const QString &key = QString());
@@ -41,16 +46,42 @@ public:
 	static SettingsManager* getInstance();
 	static QVariant getDefaultValue(const QString &key);
 	static QVariant getValue(const QString &key, const QUrl &url = QUrl());
+	static QVariantHash getOptions(const QUrl &url);
 	static bool hasOverride(const QUrl &url, const QString &key = QString());
 
 protected:
 	explicit SettingsManager(QObject *parent = NULL);
 
+	void timerEvent(QTimerEvent *event);
+	void scheduleSave(const QString &key, bool overrides);
+	void watchFiles();
+	static void readGlobalValues(const QString &path, QHash<QString, QVariant> &values);
+	static void readOverrideValues(const QString &path, QHash<QString, QHash<QString, QVariant> > &values);
+	static void writeValues(const QString &globalPath, const QHash<QString, QVariant> &globalValues, const QString &overridePath, const QHash<QString, QHash<QString, QVariant> > &overrideValues);
+	static QHash<QString, QVariant> getModifiedGlobalValues();
+	static QHash<QString, QHash<QString, QVariant> > getModifiedOverrideValues();
+	static QString getHost(const QUrl &url);
+
+protected slots:
+	void fileChanged(const QString &path);
+	void saveFinished();
+
 private:
+	QFileSystemWatcher *m_fileSystemWatcher;
+	QFutureWatcher<void> m_saveWatcher;
+	int m_saveTimer;
+	bool m_isGlobalChanged;
+	bool m_isOverrideChanged;
+
 	static SettingsManager *m_instance;
 	static QString m_globalPath;
 	static QString m_overridePath;
 	static QHash<QString, QVariant> m_defaults;
+	static QHash<QString, QVariant> m_globalValues;
+	static QHash<QString, QHash<QString, QVariant> > m_overrideValues;
+	static QHash<QString, QVariantHash> m_hostOptions;
+	static QSet<QString> m_modifiedGlobalKeys;
+	static QSet<QString> m_modifiedOverrideHosts;
 
 signals:
 	void valueChanged(QString key, QVariant value);
@@ -20,6 +20,7 @@
 
 #include "QtWebKitNetworkManager.h"
 #include "QtWebKitWebWidget.h"
+#include "../../../../core/BlockedContentNetworkReply.h"
 #include "../../../../core/ContentBlockingManager.h"
 #include "../../../../core/Console.h"
 #include "../../../../core/CookieJar.h"
@@ -293,12 +294,13 @@ void QtWebKitNetworkManager::updateStatus()
 
 void QtWebKitNetworkManager::updateOptions(const QUrl &url)
 {
-	QString acceptLanguage = SettingsManager::getValue(QLatin1String("Network/AcceptLanguage"), url).toString();
+	const QVariantHash options = SettingsManager::getOptions(url);
+	QString acceptLanguage = options.value(QLatin1String("Network/AcceptLanguage")).toString();
 	acceptLanguage = ((acceptLanguage.isEmpty()) ? QLatin1String(" ") : acceptLanguage.replace(QLatin1String("system"), QLocale::system().bcp47Name()));
 
 	m_acceptLanguage = ((acceptLanguage == NetworkManagerFactory::getAcceptLanguage()) ? QString() : acceptLanguage);
 
-	const QString policyValue = SettingsManager::getValue(QLatin1String("Network/DoNotTrackPolicy"), url).toString();
+	const QString policyValue = options.value(QLatin1String("Network/DoNotTrackPolicy")).toString();
 
 	if (policyValue == QLatin1String("allow"))
 	{
@@ -313,7 +315,7 @@ void QtWebKitNetworkManager::updateOptions(const QUrl &url)
 		m_doNotTrackPolicy = NetworkManagerFactory::SkipTrackPolicy;
 	}
 
-	m_canSendReferrer = SettingsManager::getValue(QLatin1String("Network/EnableReferrer"), url).toBool();
+	m_canSendReferrer = options.value(QLatin1String("Network/EnableReferrer")).toBool();
 }
 
 void QtWebKitNetworkManager::setFormRequest(const QUrl &url)
@@ -349,12 +351,12 @@ QNetworkReply* QtWebKitNetworkManager::createRequest(QNetworkAccessManager::Oper
 
 	if (ContentBlockingManager::isContentBlockingEnabled() && ContentBlockingManager::isUrlBlocked(request, m_widget->getUrl()))
 	{
-		Console::addMessage(QCoreApplication::translate("main", "Blocked content: %0").arg(request.url().url()), Otter::NetworkMessageCategory, LogMessageLevel);
-
-		QUrl url = QUrl();
-		url.setScheme(QLatin1String("http"));
+		if (Console::hasListeners())
+		{
+			Console::addMessage(QCoreApplication::translate("main", "Blocked content: %0").arg(request.url().url()), Otter::NetworkMessageCategory, LogMessageLevel);
+		}
 
-		return QNetworkAccessManager::createRequest(QNetworkAccessManager::GetOperation, QNetworkRequest(url));
+		return new BlockedContentNetworkReply(this, request, operation);
 	}
 
 	if (operation == GetOperation && request.url().isLocalFile() && QFileInfo(request.url().toLocalFile()).isDir())
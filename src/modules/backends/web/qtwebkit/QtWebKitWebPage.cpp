@@ -52,6 +52,7 @@ QtWebKitWebPage::QtWebKitWebPage(QtWebKitNetworkManager *networkManager, QtWebKi
 	m_widget(parent),
 	m_backend(WebBackendsManager::getBackend(QLatin1String("qtwebkit"))),
 	m_networkManager(networkManager),
+	m_styleSheetsGeneration(-1),
 	m_ignoreJavaScriptPopups(false)
 {
 	setNetworkAccessManager(m_networkManager);
@@ -67,6 +68,7 @@ QtWebKitWebPage::QtWebKitWebPage() : QWebPage(),
 	m_widget(NULL),
 	m_backend(NULL),
 	m_networkManager(NULL),
+	m_styleSheetsGeneration(-1),
 	m_ignoreJavaScriptPopups(false)
 {
 }
@@ -86,25 +88,18 @@ void QtWebKitWebPage::pageLoadFinished()
 	m_ignoreJavaScriptPopups = false;
 
 	updatePageStyleSheets();
-
-	if (ContentBlockingManager::isContentBlockingEnabled() && mainFrame()->url().isValid())
-	{
-		const QStringList domainList = ContentBlockingManager::createSubdomainList(mainFrame()->url().host());
-
-		updateBlockedPageElements(domainList, false);
-		updateBlockedPageElements(domainList, true);
-	}
 }
 
 void QtWebKitWebPage::updatePageStyleSheets(const QUrl &url)
 {
 	const QUrl currentUrl = (url.isEmpty() ? mainFrame()->url() : url);
-	QString styleSheet = QString(QStringLiteral("html {color: %1;} a {color: %2;} a:visited {color: %3;}")).arg(SettingsManager::getValue(QLatin1String("Content/TextColor")).toString()).arg(SettingsManager::getValue(QLatin1String("Content/LinkColor")).toString()).arg(SettingsManager::getValue(QLatin1String("Content/VisitedLinkColor")).toString()).toUtf8() + ContentBlockingManager::getStyleSheetHidingRules();
+	const QString colorsStyleSheet = QString(QStringLiteral("html {color: %1;} a {color: %2;} a:visited {color: %3;}\n")).arg(SettingsManager::getValue(QLatin1String("Content/TextColor")).toString()).arg(SettingsManager::getValue(QLatin1String("Content/LinkColor")).toString()).arg(SettingsManager::getValue(QLatin1String("Content/VisitedLinkColor")).toString());
+	QByteArray styleSheet;
 	QWebElement image = mainFrame()->findFirstElement(QLatin1String("img"));
 
 	if (!image.isNull() && QUrl(image.attribute(QLatin1String("src"))) == currentUrl)
 	{
-		styleSheet += QLatin1String("html {width:100%;height:100%;} body {display:-webkit-flex;-webkit-align-items:center;} img {display:block;margin:auto;-webkit-user-select:none;} .hidden {display:none;} .zoomedIn {display:table;} .zoomedIn body {display:table-cell;vertical-align:middle;} .zoomedIn img {cursor:-webkit-zoom-out;} .zoomedIn .drag {cursor:move;} .zoomedOut img {max-width:100%;max-height:100%;cursor:-webkit-zoom-in;}");
+		styleSheet.append("html {width:100%;height:100%;} body {display:-webkit-flex;-webkit-align-items:center;} img {display:block;margin:auto;-webkit-user-select:none;} .hidden {display:none;} .zoomedIn {display:table;} .zoomedIn body {display:table-cell;vertical-align:middle;} .zoomedIn img {cursor:-webkit-zoom-out;} .zoomedIn .drag {cursor:move;} .zoomedOut img {max-width:100%;max-height:100%;cursor:-webkit-zoom-in;}");
 
 		settings()->setAttribute(QWebSettings::JavascriptEnabled, true);
 
@@ -124,39 +119,23 @@ void QtWebKitWebPage::updatePageStyleSheets(const QUrl &url)
 		styleSheet.append(file.readAll());
 	}
 
-	settings()->setUserStyleSheetUrl(QUrl(QLatin1String("data:text/css;charset=utf-8;base64,") + styleSheet.toUtf8().toBase64()));
-}
+	styleSheet.prepend(colorsStyleSheet.toUtf8());
 
-void QtWebKitWebPage::updateBlockedPageElements(const QStringList domainList, const bool isException)
-{
-	for (int i = 0; i < domainList.count(); ++i)
-	{
-		const QList<QString> exceptionList = isException ? ContentBlockingManager::getHidingRulesExceptions().values(domainList.at(i)) : ContentBlockingManager::getSpecificDomainHidingRules().values(domainList.at(i));
+	const QString host = (ContentBlockingManager::isContentBlockingEnabled() ? currentUrl.host() : QString());
+	const int generation = ContentBlockingManager::getStyleSheetsGeneration();
 
-		for (int j = 0; j < exceptionList.count(); ++j)
-		{
-			const QWebElementCollection elements = mainFrame()->documentElement().findAll(exceptionList.at(j));
-
-			for (int k = 0; k < elements.count(); ++k)
-			{
-				QWebElement element = elements.at(k);
-
-				if (element.isNull())
-				{
-					continue;
-				}
-
-				if (isException)
-				{
-					element.setStyleProperty(QLatin1String("display"), QLatin1String("block"));
-				}
-				else
-				{
-					element.removeFromDocument();
-				}
-			}
-		}
+	if (generation == m_styleSheetsGeneration && host == m_styleSheetHost && styleSheet == m_styleSheet)
+	{
+		return;
 	}
+
+	m_styleSheet = styleSheet;
+	m_styleSheetHost = host;
+	m_styleSheetsGeneration = generation;
+
+	const QByteArray encodedStyleSheet = (ContentBlockingManager::getEncodedStyleSheet(host) + (host.isEmpty() ? QByteArray() : ContentBlockingManager::getEncodedDomainStyleSheet(host)) + ContentBlockingManager::encodeStyleSheet(styleSheet));
+
+	settings()->setUserStyleSheetUrl(QUrl(QLatin1String("data:text/css;charset=utf-8;base64,") + QString::fromLatin1(encodedStyleSheet)));
 }
 
 void QtWebKitWebPage::javaScriptAlert(QWebFrame *frame, const QString &message)
@@ -235,7 +214,14 @@ QWebPage* QtWebKitWebPage::createWindow(QWebPage::WebWindowType type)
 
 QString QtWebKitWebPage::userAgentForUrl(const QUrl &url) const
 {
-	return m_backend->getUserAgent(m_widget ? NetworkManagerFactory::getUserAgent(m_widget->getOption(QLatin1String("Network/UserAgent"), url).toString()).value : QString());
+	if (!m_widget)
+	{
+		return m_backend->getUserAgent(QString());
+	}
+
+	const QString userAgent = (m_widget->hasOption(QLatin1String("Network/UserAgent")) ? m_widget->getOption(QLatin1String("Network/UserAgent")) : SettingsManager::getOptions(url.isEmpty() ? m_widget->getUrl() : url).value(QLatin1String("Network/UserAgent"))).toString();
+
+	return m_backend->getUserAgent(NetworkManagerFactory::getUserAgent(userAgent).value);
 }
 
 QString QtWebKitWebPage::getDefaultUserAgent() const
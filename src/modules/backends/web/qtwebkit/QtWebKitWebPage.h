@@ -52,7 +52,6 @@ public slots:
 protected:
 	QtWebKitWebPage();
 
-	void updateBlockedPageElements(const QStringList domainList, const bool isException);
 	void javaScriptAlert(QWebFrame *frame, const QString &message);
 	void javaScriptConsoleMessage(const QString &note, int line, const QString &source);
 	QWebPage* createWindow(WebWindowType type);
@@ -70,6 +69,9 @@ private:
 	QtWebKitWebWidget *m_widget;
 	WebBackend *m_backend;
 	QtWebKitNetworkManager *m_networkManager;
+	QByteArray m_styleSheet;
+	QString m_styleSheetHost;
+	int m_styleSheetsGeneration;
 	bool m_ignoreJavaScriptPopups;
 
 signals:
@@ -872,20 +872,29 @@ void QtWebKitWebWidget::updateBookmarkActions()
 
 void QtWebKitWebWidget::updateOptions(const QUrl &url)
 {
+	QVariantHash options = SettingsManager::getOptions(url);
+	const QVariantHash widgetOptions = getOptions();
+	QVariantHash::const_iterator iterator;
+
+	for (iterator = widgetOptions.constBegin(); iterator != widgetOptions.constEnd(); ++iterator)
+	{
+		options[iterator.key()] = iterator.value();
+	}
+
 	QWebSettings *settings = m_webView->page()->settings();
-	settings->setAttribute(QWebSettings::AutoLoadImages, getOption(QLatin1String("Browser/EnableImages"), url).toBool());
-	settings->setAttribute(QWebSettings::PluginsEnabled, getOption(QLatin1String("Browser/EnablePlugins"), url).toString() != QLatin1String("disabled"));
-	settings->setAttribute(QWebSettings::JavaEnabled, getOption(QLatin1String("Browser/EnableJava"), url).toBool());
-	settings->setAttribute(QWebSettings::JavascriptEnabled, getOption(QLatin1String("Browser/EnableJavaScript"), url).toBool());
-	settings->setAttribute(QWebSettings::JavascriptCanAccessClipboard, getOption(QLatin1String("Browser/JavaScriptCanAccessClipboard"), url).toBool());
-	settings->setAttribute(QWebSettings::JavascriptCanCloseWindows, getOption(QLatin1String("Browser/JavaScriptCanCloseWindows"), url).toBool());
-	settings->setAttribute(QWebSettings::JavascriptCanOpenWindows, getOption(QLatin1String("Browser/JavaScriptCanOpenWindows"), url).toBool());
-	settings->setAttribute(QWebSettings::LocalStorageEnabled, getOption(QLatin1String("Browser/EnableLocalStorage"), url).toBool());
-	settings->setAttribute(QWebSettings::OfflineStorageDatabaseEnabled, getOption(QLatin1String("Browser/EnableOfflineStorageDatabase"), url).toBool());
-	settings->setAttribute(QWebSettings::OfflineWebApplicationCacheEnabled, getOption(QLatin1String("Browser/EnableOfflineWebApplicationCache"), url).toBool());
-	settings->setDefaultTextEncoding(getOption(QLatin1String("Content/DefaultCharacterEncoding"), url).toString());
-
-	const QString thirdPartyCookiesPolicy = SettingsManager::getValue(QLatin1String("Network/ThirdPartyCookiesPolicy"), url).toString();
+	settings->setAttribute(QWebSettings::AutoLoadImages, options.value(QLatin1String("Browser/EnableImages")).toBool());
+	settings->setAttribute(QWebSettings::PluginsEnabled, options.value(QLatin1String("Browser/EnablePlugins")).toString() != QLatin1String("disabled"));
+	settings->setAttribute(QWebSettings::JavaEnabled, options.value(QLatin1String("Browser/EnableJava")).toBool());
+	settings->setAttribute(QWebSettings::JavascriptEnabled, options.value(QLatin1String("Browser/EnableJavaScript")).toBool());
+	settings->setAttribute(QWebSettings::JavascriptCanAccessClipboard, options.value(QLatin1String("Browser/JavaScriptCanAccessClipboard")).toBool());
+	settings->setAttribute(QWebSettings::JavascriptCanCloseWindows, options.value(QLatin1String("Browser/JavaScriptCanCloseWindows")).toBool());
+	settings->setAttribute(QWebSettings::JavascriptCanOpenWindows, options.value(QLatin1String("Browser/JavaScriptCanOpenWindows")).toBool());
+	settings->setAttribute(QWebSettings::LocalStorageEnabled, options.value(QLatin1String("Browser/EnableLocalStorage")).toBool());
+	settings->setAttribute(QWebSettings::OfflineStorageDatabaseEnabled, options.value(QLatin1String("Browser/EnableOfflineStorageDatabase")).toBool());
+	settings->setAttribute(QWebSettings::OfflineWebApplicationCacheEnabled, options.value(QLatin1String("Browser/EnableOfflineWebApplicationCache")).toBool());
+	settings->setDefaultTextEncoding(options.value(QLatin1String("Content/DefaultCharacterEncoding")).toString());
+
+	const QString thirdPartyCookiesPolicy = options.value(QLatin1String("Network/ThirdPartyCookiesPolicy")).toString();
 
 	if (thirdPartyCookiesPolicy == QLatin1String("acceptExisting"))
 	{
@@ -902,7 +911,7 @@ void QtWebKitWebWidget::updateOptions(const QUrl &url)
 
 	disconnect(m_webView->page(), SIGNAL(statusBarMessage(QString)), this, SLOT(setStatusMessage(QString)));
 
-	if (getOption(QLatin1String("Browser/JavaScriptCanShowStatusMessages"), url).toBool())
+	if (options.value(QLatin1String("Browser/JavaScriptCanShowStatusMessages")).toBool())
 	{
 		connect(m_webView->page(), SIGNAL(statusBarMessage(QString)), this, SLOT(setStatusMessage(QString)));
 	}
@@ -915,7 +924,7 @@ void QtWebKitWebWidget::updateOptions(const QUrl &url)
 
 	m_networkManager->updateOptions(url);
 
-	m_canLoadPlugins = (getOption(QLatin1String("Browser/EnablePlugins"), url).toString() == QLatin1String("enabled"));
+	m_canLoadPlugins = (options.value(QLatin1String("Browser/EnablePlugins")).toString() == QLatin1String("enabled"));
 }
 
 void QtWebKitWebWidget::clearOptions()
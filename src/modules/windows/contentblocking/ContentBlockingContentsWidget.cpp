@@ -0,0 +1,185 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2014 Jan Bajer aka bajasoft <jbajer@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#include "ContentBlockingContentsWidget.h"
+#include "../../../core/ContentBlockingList.h"
+#include "../../../core/ContentBlockingManager.h"
+#include "../../../core/Utils.h"
+#include "../../../ui/ItemDelegate.h"
+
+#include "ui_ContentBlockingContentsWidget.h"
+
+namespace Otter
+{
+
+ContentBlockingContentsWidget::ContentBlockingContentsWidget(Window *window) : ContentsWidget(window),
+	m_model(new QStandardItemModel(this)),
+	m_ui(new Ui::ContentBlockingContentsWidget)
+{
+	m_ui->setupUi(this);
+	m_ui->statisticsView->setModel(m_model);
+	m_ui->statisticsView->setItemDelegate(new ItemDelegate(this));
+	m_ui->statisticsView->header()->setTextElideMode(Qt::ElideRight);
+
+	updateStatistics();
+
+	connect(ContentBlockingManager::getInstance(), SIGNAL(styleSheetsUpdated()), this, SLOT(updateStatistics()));
+	connect(m_ui->refreshButton, SIGNAL(clicked()), this, SLOT(updateStatistics()));
+	connect(m_ui->logButton, SIGNAL(clicked()), this, SLOT(logStatistics()));
+}
+
+ContentBlockingContentsWidget::~ContentBlockingContentsWidget()
+{
+	delete m_ui;
+}
+
+void ContentBlockingContentsWidget::changeEvent(QEvent *event)
+{
+	QWidget::changeEvent(event);
+
+	switch (event->type())
+	{
+		case QEvent::LanguageChange:
+			m_ui->retranslateUi(this);
+
+			updateStatistics();
+
+			break;
+		default:
+			break;
+	}
+}
+
+void ContentBlockingContentsWidget::print(QPrinter *printer)
+{
+	m_ui->statisticsView->render(printer);
+}
+
+void ContentBlockingContentsWidget::addEntry(QStandardItem *parent, const QString &name, const QString &value)
+{
+	QList<QStandardItem*> items;
+	items.append(new QStandardItem(name));
+	items.append(new QStandardItem(value));
+	items[0]->setToolTip(name);
+
+	parent->appendRow(items);
+}
+
+void ContentBlockingContentsWidget::logStatistics()
+{
+	ContentBlockingManager::logStatistics();
+}
+
+void ContentBlockingContentsWidget::updateStatistics()
+{
+	m_model->clear();
+
+	QStringList labels;
+	labels << tr("Name") << tr("Value");
+
+	m_model->setHorizontalHeaderLabels(labels);
+
+	const ContentBlockingStatistics statistics = ContentBlockingManager::getStatistics();
+	const qint64 lookups = (statistics.cacheHits + statistics.cacheMisses);
+	QStandardItem *generalItem = new QStandardItem(Utils::getIcon(QLatin1String("inode-directory")), tr("Overview"));
+
+	addEntry(generalItem, tr("Lookups"), QString::number(lookups));
+	addEntry(generalItem, tr("Blocked requests"), QString::number(statistics.blockedRequests));
+	addEntry(generalItem, tr("Cached decisions"), QString::number(statistics.cacheHits));
+	addEntry(generalItem, tr("Evaluated requests"), QString::number(statistics.cacheMisses));
+	addEntry(generalItem, tr("Total evaluation time"), formatTime(statistics.evaluationTime));
+	addEntry(generalItem, tr("Average evaluation time"), formatTime(statistics.evaluationTime / qMax(Q_INT64_C(1), statistics.cacheMisses)));
+	addEntry(generalItem, tr("Median evaluation time"), formatTime(statistics.medianEvaluationTime));
+	addEntry(generalItem, tr("99th percentile of evaluation time"), formatTime(statistics.highEvaluationTime));
+	addEntry(generalItem, tr("Maximum evaluation time"), formatTime(statistics.maximumEvaluationTime));
+	addEntry(generalItem, tr("Time saved by cache"), formatTime(statistics.savedTime));
+	addEntry(generalItem, tr("Pages with cosmetic filtering"), QString::number(statistics.cosmeticFilteringPages));
+	addEntry(generalItem, tr("Average cosmetic filtering time"), formatTime(statistics.cosmeticFilteringTime / qMax(Q_INT64_C(1), statistics.cosmeticFilteringPages)));
+	addEntry(generalItem, tr("Maximum cosmetic filtering time"), formatTime(statistics.maximumCosmeticFilteringTime));
+
+	m_model->appendRow(generalItem);
+
+	const QList<ContentBlockingList*> lists = ContentBlockingManager::getBlockingDefinitions();
+
+	for (int i = 0; i < lists.count(); ++i)
+	{
+		if (!lists.at(i)->isEnabled())
+		{
+			continue;
+		}
+
+		const ContentBlockingListStatistics listStatistics = lists.at(i)->getStatistics();
+		QStandardItem *listItem = new QStandardItem(Utils::getIcon(QLatin1String("inode-directory")), (lists.at(i)->getListName().isEmpty() ? lists.at(i)->getFileName() : lists.at(i)->getListName()));
+
+		addEntry(listItem, tr("Rules"), QString::number(listStatistics.rulesAmount));
+		addEntry(listItem, tr("Cosmetic rules"), QString::number(listStatistics.cosmeticRulesAmount));
+		addEntry(listItem, tr("Skipped rules"), QString::number(listStatistics.skippedRulesAmount));
+		addEntry(listItem, tr("Memory usage"), Utils::formatUnit(listStatistics.memoryUsage));
+		addEntry(listItem, tr("Lookups"), QString::number(listStatistics.lookups));
+		addEntry(listItem, tr("Hits"), QString::number(listStatistics.hits));
+
+		if (!listStatistics.rulesHits.isEmpty())
+		{
+			QStandardItem *rulesItem = new QStandardItem(tr("Most used rules"));
+
+			for (int j = 0; j < listStatistics.rulesHits.count(); ++j)
+			{
+				addEntry(rulesItem, listStatistics.rulesHits.at(j).first, QString::number(listStatistics.rulesHits.at(j).second));
+			}
+
+			listItem->appendRow(rulesItem);
+		}
+
+		m_model->appendRow(listItem);
+	}
+
+	m_ui->statisticsView->expandAll();
+}
+
+QString ContentBlockingContentsWidget::formatTime(qint64 time)
+{
+	if (time >= 1000000)
+	{
+		return tr("%1 ms").arg((time / 1000000.0), 0, 'f', 2);
+	}
+
+	return tr("%1 µs").arg((time / 1000.0), 0, 'f', 1);
+}
+
+QString ContentBlockingContentsWidget::getTitle() const
+{
+	return tr("Content Blocking Statistics");
+}
+
+QLatin1String ContentBlockingContentsWidget::getType() const
+{
+	return QLatin1String("contentblocking");
+}
+
+QUrl ContentBlockingContentsWidget::getUrl() const
+{
+	return QUrl(QLatin1String("about:contentblocking"));
+}
+
+QIcon ContentBlockingContentsWidget::getIcon() const
+{
+	return Utils::getIcon(QLatin1String("process-stop"));
+}
+
+}
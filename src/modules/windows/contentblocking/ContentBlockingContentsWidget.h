@@ -0,0 +1,67 @@
+/**************************************************************************
+* Otter Browser: Web browser controlled by the user, not vice-versa.
+* Copyright (C) 2014 Jan Bajer aka bajasoft <jbajer@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+**************************************************************************/
+
+#ifndef OTTER_CONTENTBLOCKINGCONTENTSWIDGET_H
+#define OTTER_CONTENTBLOCKINGCONTENTSWIDGET_H
+
+#include "../../../ui/ContentsWidget.h"
+
+#include <QtGui/QStandardItemModel>
+
+namespace Otter
+{
+
+namespace Ui
+{
+	class ContentBlockingContentsWidget;
+}
+
+class Window;
+
+class ContentBlockingContentsWidget : public ContentsWidget
+{
+	Q_OBJECT
+
+public:
+	explicit ContentBlockingContentsWidget(Window *window);
+	~ContentBlockingContentsWidget();
+
+	void print(QPrinter *printer);
+	QString getTitle() const;
+	QLatin1String getType() const;
+	QUrl getUrl() const;
+	QIcon getIcon() const;
+
+protected:
+	void changeEvent(QEvent *event);
+	void addEntry(QStandardItem *parent, const QString &name, const QString &value);
+	static QString formatTime(qint64 time);
+
+protected slots:
+	void logStatistics();
+	void updateStatistics();
+
+private:
+	QStandardItemModel *m_model;
+	Ui::ContentBlockingContentsWidget *m_ui;
+};
+
+}
+
+#endif
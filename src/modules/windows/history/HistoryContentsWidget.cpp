@@ -20,69 +20,61 @@
 #include "HistoryContentsWidget.h"
 #include "../../../core/ActionsManager.h"
 #include "../../../core/HistoryManager.h"
+#include "../../../core/HistoryModel.h"
 #include "../../../core/Utils.h"
 #include "../../../ui/ItemDelegate.h"
 
 #include "ui_HistoryContentsWidget.h"
 
-#include <QtCore/QTimer>
+#include <QtCore/QTimerEvent>
 #include <QtGui/QClipboard>
 #include <QtGui/QMouseEvent>
 #include <QtWidgets/QMenu>
+#include <QtWidgets/QScrollBar>
 
 namespace Otter
 {
 
 HistoryContentsWidget::HistoryContentsWidget(Window *window) : ContentsWidget(window),
-	m_model(new QStandardItemModel(this)),
-	m_isLoading(true),
+	m_model(new HistoryModel(this)),
+	m_filterTimer(0),
+	m_fetchTimer(0),
 	m_ui(new Ui::HistoryContentsWidget)
 {
 	m_ui->setupUi(this);
-
-	QStringList groups;
-	groups << tr("Today") << tr("Yesterday") << tr("Earlier This Week") << tr("Previous Week") << tr("Earlier This Month") << tr("Earlier This Year") << tr("Older");
-
-	for (int i = 0; i < groups.count(); ++i)
-	{
-		m_model->appendRow(new QStandardItem(Utils::getIcon(QLatin1String("inode-directory")), groups.at(i)));
-	}
-
-	QStringList labels;
-	labels << tr("Address") << tr("Title") << tr("Date");
-
-	m_model->setHorizontalHeaderLabels(labels);
-	m_model->setSortRole(Qt::DisplayRole);
-
 	m_ui->historyView->setModel(m_model);
 	m_ui->historyView->setItemDelegate(new ItemDelegate(this));
 	m_ui->historyView->header()->setTextElideMode(Qt::ElideRight);
 	m_ui->historyView->header()->setSectionResizeMode(0, QHeaderView::Stretch);
 	m_ui->historyView->viewport()->installEventFilter(this);
 
-	for (int i = 0; i < m_model->rowCount(); ++i)
-	{
-		m_ui->historyView->setRowHidden(i, m_model->invisibleRootItem()->index(), true);
-	}
+	updateGroups();
 
 	const QString expandBranches = SettingsManager::getValue(QLatin1String("History/ExpandBranches")).toString();
 
 	if (expandBranches == QLatin1String("first"))
 	{
-		m_ui->historyView->expand(m_model->index(0, 0));
+		for (int i = 0; i < m_model->rowCount(); ++i)
+		{
+			if (m_model->hasEntries(i))
+			{
+				m_ui->historyView->expand(m_model->index(i, 0));
+
+				break;
+			}
+		}
 	}
 	else if (expandBranches == QLatin1String("all"))
 	{
 		m_ui->historyView->expandAll();
 	}
 
-	QTimer::singleShot(100, this, SLOT(populateEntries()));
-
-	connect(HistoryManager::getInstance(), SIGNAL(cleared()), this, SLOT(populateEntries()));
-	connect(HistoryManager::getInstance(), SIGNAL(entryAdded(qint64)), this, SLOT(addEntry(qint64)));
-	connect(HistoryManager::getInstance(), SIGNAL(entryUpdated(qint64)), this, SLOT(updateEntry(qint64)));
-	connect(HistoryManager::getInstance(), SIGNAL(entryRemoved(qint64)), this, SLOT(removeEntry(qint64)));
-	connect(HistoryManager::getInstance(), SIGNAL(dayChanged()), this, SLOT(populateEntries()));
+	connect(m_model, SIGNAL(modelReset()), this, SLOT(updateGroups()));
+	connect(m_model, SIGNAL(dataChanged(QModelIndex,QModelIndex)), this, SLOT(updateGroups()));
+	connect(m_model, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(scheduleFetch()));
+	connect(m_ui->historyView, SIGNAL(expanded(QModelIndex)), this, SLOT(scheduleFetch()));
+	connect(m_ui->historyView->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(scheduleFetch()));
+	connect(m_ui->historyView->verticalScrollBar(), SIGNAL(rangeChanged(int,int)), this, SLOT(scheduleFetch()));
 	connect(m_ui->filterLineEdit, SIGNAL(textChanged(QString)), this, SLOT(filterHistory(QString)));
 	connect(m_ui->historyView, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(openEntry(QModelIndex)));
 	connect(m_ui->historyView, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(showContextMenu(QPoint)));
@@ -93,6 +85,35 @@ HistoryContentsWidget::~HistoryContentsWidget()
 	delete m_ui;
 }
 
+void HistoryContentsWidget::timerEvent(QTimerEvent *event)
+{
+	if (event->timerId() == m_filterTimer)
+	{
+		killTimer(m_filterTimer);
+
+		m_filterTimer = 0;
+
+		const QString filter = m_ui->filterLineEdit->text();
+
+		m_model->setFilter(filter);
+
+		if (!filter.isEmpty())
+		{
+			m_ui->historyView->expandAll();
+		}
+
+		scheduleFetch();
+	}
+	else if (event->timerId() == m_fetchTimer)
+	{
+		killTimer(m_fetchTimer);
+
+		m_fetchTimer = 0;
+
+		fetchVisibleEntries();
+	}
+}
+
 void HistoryContentsWidget::changeEvent(QEvent *event)
 {
 	QWidget::changeEvent(event);
@@ -115,173 +136,52 @@ void HistoryContentsWidget::print(QPrinter *printer)
 
 void HistoryContentsWidget::filterHistory(const QString &filter)
 {
-	for (int i = 0; i < m_model->rowCount(); ++i)
-	{
-		QStandardItem *groupItem = m_model->item(i, 0);
+	Q_UNUSED(filter)
 
-		if (!groupItem)
-		{
-			continue;
-		}
-
-		bool found = (filter.isEmpty() && groupItem->rowCount() > 0);
-
-		for (int j = 0; j < groupItem->rowCount(); ++j)
-		{
-			QStandardItem *entryItem = groupItem->child(j, 0);
-
-			if (!entryItem)
-			{
-				continue;
-			}
-
-			const bool match = (filter.isEmpty() || entryItem->text().contains(filter, Qt::CaseInsensitive) || groupItem->child(j, 1)->text().contains(filter, Qt::CaseInsensitive));
-
-			if (match)
-			{
-				found = true;
-			}
-
-			m_ui->historyView->setRowHidden(j, groupItem->index(), !match);
-		}
-
-		m_ui->historyView->setRowHidden(i, m_model->invisibleRootItem()->index(), !found);
-		m_ui->historyView->setExpanded(groupItem->index(), !filter.isEmpty());
-	}
-}
-
-void HistoryContentsWidget::populateEntries()
-{
-	const QDate date = QDate::currentDate();
-	QList<QDate> dates;
-	dates << date << date.addDays(-1) << date.addDays(-7) << date.addDays(-14) << date.addDays(-30) << date.addDays(-365);
-
-	for (int i = 0; i < m_model->rowCount(); ++i)
+	if (m_filterTimer != 0)
 	{
-		QStandardItem *groupItem = m_model->item(i, 0);
-
-		if (groupItem)
-		{
-			groupItem->setData(dates.value(i, QDate()), Qt::UserRole);
-			groupItem->removeRows(0, groupItem->rowCount());
-		}
-	}
-
-	const QList<HistoryEntry> entries = HistoryManager::getEntries();
-
-	for (int i = 0; i < entries.count(); ++i)
-	{
-		addEntry(entries.at(i));
-	}
-
-	for (int i = 0; i < m_model->rowCount(); ++i)
-	{
-		QStandardItem *groupItem = m_model->item(i, 0);
-
-		if (groupItem)
-		{
-			groupItem->sortChildren(2, Qt::DescendingOrder);
-		}
+		killTimer(m_filterTimer);
 	}
 
-	m_isLoading = false;
-
-	emit loadingChanged(false);
-}
-
-void HistoryContentsWidget::addEntry(qint64 entry)
-{
-	addEntry(HistoryManager::getEntry(entry));
+	m_filterTimer = startTimer(250);
 }
 
-void HistoryContentsWidget::addEntry(const HistoryEntry &entry)
+void HistoryContentsWidget::fetchVisibleEntries()
 {
-	if (entry.identifier < 0)
-	{
-		return;
-	}
-
-	QStandardItem *groupItem = NULL;
+	const QRect viewportRect = m_ui->historyView->viewport()->rect();
 
 	for (int i = 0; i < m_model->rowCount(); ++i)
 	{
-		groupItem = m_model->item(i, 0);
+		const QModelIndex groupIndex = m_model->index(i, 0);
 
-		if (groupItem && (entry.time.date() >= groupItem->data(Qt::UserRole).toDate() || !groupItem->data(Qt::UserRole).toDate().isValid()))
+		if (!m_ui->historyView->isExpanded(groupIndex) || !m_model->canFetchMore(groupIndex))
 		{
-			break;
+			continue;
 		}
 
-		groupItem = NULL;
-	}
-
-	if (!groupItem)
-	{
-		return;
-	}
-
-	QList<QStandardItem*> entryItems;
-	entryItems.append(new QStandardItem((entry.icon.isNull() ? Utils::getIcon(QLatin1String("text-html")) : entry.icon), entry.url.toString().replace(QLatin1String("%23"), QString(QLatin1Char('#')))));
-	entryItems.append(new QStandardItem(entry.title.isEmpty() ? tr("(Untitled)") : entry.title));
-	entryItems.append(new QStandardItem(entry.time.toString()));
-	entryItems[0]->setData(entry.identifier, Qt::UserRole);
-
-	groupItem->appendRow(entryItems);
+		const int rows = m_model->rowCount(groupIndex);
+		const QRect lastRect = m_ui->historyView->visualRect((rows > 0) ? m_model->index((rows - 1), 0, groupIndex) : groupIndex);
 
-	m_ui->historyView->setRowHidden(groupItem->row(), groupItem->index().parent(), false);
-
-	if (sender())
-	{
-		groupItem->sortChildren(2, Qt::DescendingOrder);
-	}
-
-	if (!m_ui->filterLineEdit->text().isEmpty())
-	{
-		filterHistory(m_ui->filterLineEdit->text());
+		if (lastRect.isValid() && lastRect.intersects(viewportRect))
+		{
+			m_model->fetchMore(groupIndex);
+		}
 	}
 }
 
-void HistoryContentsWidget::updateEntry(qint64 entry)
+void HistoryContentsWidget::scheduleFetch()
 {
-	QStandardItem *entryItem = findEntry(entry);
-
-	if (!entryItem)
+	if (m_fetchTimer == 0)
 	{
-		addEntry(entry);
-
-		return;
-	}
-
-	HistoryEntry historyEntry = HistoryManager::getEntry(entry);
-
-	entryItem->setIcon(historyEntry.icon.isNull() ? Utils::getIcon(QLatin1String("text-html")) : historyEntry.icon);
-	entryItem->setText(historyEntry.url.toString());
-	entryItem->parent()->child(entryItem->row(), 1)->setText(historyEntry.title.isEmpty() ? tr("(Untitled)") : historyEntry.title);
-	entryItem->parent()->child(entryItem->row(), 2)->setText(historyEntry.time.toString());
-
-	if (!m_ui->filterLineEdit->text().isEmpty())
-	{
-		filterHistory(m_ui->filterLineEdit->text());
+		m_fetchTimer = startTimer(50);
 	}
 }
 
-void HistoryContentsWidget::removeEntry(qint64 entry)
+void HistoryContentsWidget::updateGroups()
 {
-	QStandardItem *entryItem = findEntry(entry);
-
-	if (entryItem)
+	for (int i = 0; i < m_model->rowCount(); ++i)
 	{
-		QStandardItem *groupItem = entryItem->parent();
-
-		if (groupItem)
-		{
-			m_model->removeRow(entryItem->row(), groupItem->index());
-
-			if (groupItem->rowCount() == 0)
-			{
-				m_ui->historyView->setRowHidden(groupItem->row(), m_model->invisibleRootItem()->index(), true);
-			}
-		}
+		m_ui->historyView->setRowHidden(i, QModelIndex(), !m_model->hasEntries(i));
 	}
 }
 
@@ -297,44 +197,21 @@ void HistoryContentsWidget::removeEntry()
 
 void HistoryContentsWidget::removeDomainEntries()
 {
-	QStandardItem *domainItem = findEntry(getEntry(m_ui->historyView->currentIndex()));
-
-	if (!domainItem)
+	if (getEntry(m_ui->historyView->currentIndex()) < 0)
 	{
 		return;
 	}
 
-	const QString host = QUrl(domainItem->text()).host();
-	QList<qint64> entries;
-
-	for (int i = 0; i < m_model->rowCount(); ++i)
-	{
-		QStandardItem *groupItem = m_model->item(i, 0);
-
-		if (!groupItem)
-		{
-			continue;
-		}
-
-		for (int j = (groupItem->rowCount() - 1); j >= 0; --j)
-		{
-			QStandardItem *entryItem = groupItem->child(j, 0);
-
-			if (entryItem && host == QUrl(entryItem->text()).host())
-			{
-				entries.append(entryItem->data(Qt::UserRole).toLongLong());
-			}
-		}
-	}
+	const QModelIndex index = m_ui->historyView->currentIndex();
 
-	HistoryManager::removeEntries(entries);
+	HistoryManager::removeEntries(m_model->getHostEntries(QUrl(index.sibling(index.row(), 0).data(Qt::DisplayRole).toString()).host()));
 }
 
 void HistoryContentsWidget::openEntry(const QModelIndex &index)
 {
 	const QModelIndex entryIndex = (index.isValid() ? index : m_ui->historyView->currentIndex());
 
-	if (!entryIndex.isValid() || entryIndex.parent() == m_model->invisibleRootItem()->index())
+	if (!entryIndex.isValid() || !entryIndex.parent().isValid())
 	{
 		return;
 	}
@@ -351,21 +228,21 @@ void HistoryContentsWidget::openEntry(const QModelIndex &index)
 
 void HistoryContentsWidget::bookmarkEntry()
 {
-	QStandardItem *entryItem = findEntry(getEntry(m_ui->historyView->currentIndex()));
+	const QModelIndex index = m_ui->historyView->currentIndex();
 
-	if (entryItem)
+	if (getEntry(index) >= 0)
 	{
-		emit requestedAddBookmark(QUrl(entryItem->text()), m_ui->historyView->currentIndex().sibling(m_ui->historyView->currentIndex().row(), 1).data(Qt::DisplayRole).toString());
+		emit requestedAddBookmark(QUrl(index.sibling(index.row(), 0).data(Qt::DisplayRole).toString()), index.sibling(index.row(), 1).data(Qt::DisplayRole).toString());
 	}
 }
 
 void HistoryContentsWidget::copyEntryLink()
 {
-	QStandardItem *entryItem = findEntry(getEntry(m_ui->historyView->currentIndex()));
+	const QModelIndex index = m_ui->historyView->currentIndex();
 
-	if (entryItem)
+	if (getEntry(index) >= 0)
 	{
-		QApplication::clipboard()->setText(entryItem->text());
+		QApplication::clipboard()->setText(index.sibling(index.row(), 0).data(Qt::DisplayRole).toString());
 	}
 }
 
@@ -395,29 +272,6 @@ void HistoryContentsWidget::showContextMenu(const QPoint &point)
 	menu.exec(m_ui->historyView->mapToGlobal(point));
 }
 
-QStandardItem* HistoryContentsWidget::findEntry(qint64 entry)
-{
-	for (int i = 0; i < m_model->rowCount(); ++i)
-	{
-		QStandardItem *groupItem = m_model->item(i, 0);
-
-		if (groupItem)
-		{
-			for (int j = 0; j < groupItem->rowCount(); ++j)
-			{
-				QStandardItem *entryItem = groupItem->child(j, 0);
-
-				if (entryItem && entry == entryItem->data(Qt::UserRole).toLongLong())
-				{
-					return entryItem;
-				}
-			}
-		}
-	}
-
-	return NULL;
-}
-
 QString HistoryContentsWidget::getTitle() const
 {
 	return tr("History");
@@ -440,12 +294,12 @@ QIcon HistoryContentsWidget::getIcon() const
 
 qint64 HistoryContentsWidget::getEntry(const QModelIndex &index) const
 {
-	return ((index.isValid() && index.parent().isValid() && index.parent().parent() == m_model->invisibleRootItem()->index()) ? index.sibling(index.row(), 0).data(Qt::UserRole).toLongLong() : -1);
+	return ((index.isValid() && index.parent().isValid()) ? index.sibling(index.row(), 0).data(Qt::UserRole).toLongLong() : -1);
 }
 
 bool HistoryContentsWidget::isLoading() const
 {
-	return m_isLoading;
+	return false;
 }
 
 bool HistoryContentsWidget::eventFilter(QObject *object, QEvent *event)
@@ -458,7 +312,7 @@ bool HistoryContentsWidget::eventFilter(QObject *object, QEvent *event)
 		{
 			const QModelIndex entryIndex = m_ui->historyView->currentIndex();
 
-			if (!entryIndex.isValid() || entryIndex.parent() == m_model->invisibleRootItem()->index())
+			if (!entryIndex.isValid() || !entryIndex.parent().isValid())
 			{
 				return ContentsWidget::eventFilter(object, event);
 			}
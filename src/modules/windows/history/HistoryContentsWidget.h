@@ -22,7 +22,7 @@
 
 #include "../../../ui/ContentsWidget.h"
 
-#include <QtGui/QStandardItemModel>
+#include <QtCore/QModelIndex>
 
 namespace Otter
 {
@@ -32,8 +32,7 @@ namespace Ui
 	class HistoryContentsWidget;
 }
 
-struct HistoryEntry;
-
+class HistoryModel;
 class Window;
 
 class HistoryContentsWidget : public ContentsWidget
@@ -53,17 +52,15 @@ public:
 	bool eventFilter(QObject *object, QEvent *event);
 
 protected:
+	void timerEvent(QTimerEvent *event);
 	void changeEvent(QEvent *event);
-	QStandardItem* findEntry(qint64 entry);
+	void fetchVisibleEntries();
 	qint64 getEntry(const QModelIndex &index) const;
 
 protected slots:
 	void filterHistory(const QString &filter);
-	void populateEntries();
-	void addEntry(qint64 entry);
-	void addEntry(const HistoryEntry &entry);
-	void updateEntry(qint64 entry);
-	void removeEntry(qint64 entry);
+	void updateGroups();
+	void scheduleFetch();
 	void removeEntry();
 	void removeDomainEntries();
 	void openEntry(const QModelIndex &index = QModelIndex());
@@ -72,8 +69,9 @@ protected slots:
 	void showContextMenu(const QPoint &point);
 
 private:
-	QStandardItemModel *m_model;
-	bool m_isLoading;
+	HistoryModel *m_model;
+	int m_filterTimer;
+	int m_fetchTimer;
 	Ui::HistoryContentsWidget *m_ui;
 };
 
@@ -425,6 +425,8 @@ void AddressWidget::updateIcons()
 
 void AddressWidget::setCompletion(const QString &text)
 {
+	AddressCompletionModel::getInstance()->setFilter(text);
+
 	m_completer->setCompletionPrefix(text);
 }
 
@@ -33,6 +33,7 @@
 #include "../modules/windows/cache/CacheContentsWidget.h"
 #include "../modules/windows/cookies/CookiesContentsWidget.h"
 #include "../modules/windows/configuration/ConfigurationContentsWidget.h"
+#include "../modules/windows/contentblocking/ContentBlockingContentsWidget.h"
 #include "../modules/windows/history/HistoryContentsWidget.h"
 #include "../modules/windows/transfers/TransfersContentsWidget.h"
 #include "../modules/windows/web/WebContentsWidget.h"
@@ -342,6 +343,10 @@ void Window::setUrl(const QUrl &url, bool typed)
 		{
 			newWidget = new ConfigurationContentsWidget(this);
 		}
+		else if (url.path() == QLatin1String("contentblocking"))
+		{
+			newWidget = new ContentBlockingContentsWidget(this);
+		}
 		else if (url.path() == QLatin1String("cookies"))
 		{
 			newWidget = new CookiesContentsWidget(this);